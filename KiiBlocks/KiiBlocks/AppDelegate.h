@@ -23,4 +23,9 @@
 
 @property (strong, nonatomic) UIWindow *window;
 
+// install this device for push and listen to the leaderboard topic, once we
+// have both a device token and a session. called when either turns up - a
+// player who logs in at game over shouldn't have to wait for the next launch
+- (void) subscribeToLeaderboard;
+
 @end
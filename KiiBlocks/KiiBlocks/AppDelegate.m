@@ -18,11 +18,35 @@
 //
 
 #import "AppDelegate.h"
+#import "ViewController.h"
+#import "LeaderboardCache.h"
+#import "LocationTracker.h"
+#import "GameMode.h"
+#import "CloudSession.h"
+#import "ScoreQueue.h"
+#import "GameAnalytics.h"
+#import "Instrumentation.h"
+
+// push goes through the APNs sandbox only in development builds
+#ifdef DEBUG
+#define APNS_DEVELOPMENT_MODE   TRUE
+#else
+#define APNS_DEVELOPMENT_MODE   FALSE
+#endif
+
+@interface AppDelegate() {
+    // TRUE once APNs has given us a token and it's been handed to Kii
+    BOOL _hasDeviceToken;
+}
+
+@end
 
 @implementation AppDelegate
 
 - (BOOL)application:(UIApplication *)application didFinishLaunchingWithOptions:(NSDictionary *)launchOptions
 {
+    [[Instrumentation sharedInstrumentation] markStartupPhase:@"launched"];
+    
     // Override point for customization after application launch.
     // Initialize the Kii SDK!
     
@@ -31,17 +55,73 @@
     
     assert(![appID isEqualToString:@"< ADD YOUR OWN APP ID AND KEY >"]);
     
-    [Kii beginWithID:appID
-              andKey:appKey
-             andSite:kiiSiteUS];
+    // the SDK starts in the background - the board shows up without waiting on it
+    CloudSession *session = [CloudSession sharedSession];
+    [session startWithAppID:appID andKey:appKey];
+    
+    [session whenReady:^{
+        
+        // register for push so leaderboard updates are delivered to us
+        [Kii enableAPNSWithDevelopmentMode:APNS_DEVELOPMENT_MODE
+                      andNotificationTypes:UIRemoteNotificationTypeNone];
+        
+        // see which game mode this player should be on - it applies from the next game
+        [GameMode fetchFromCloudWithBlock:nil];
+    }];
+    
+    // find out roughly where the player is for the 'nearby' leaderboard
+    [[LocationTracker sharedTracker] start];
     
     return YES;
 }
+
+- (void)application:(UIApplication *)application didRegisterForRemoteNotificationsWithDeviceToken:(NSData *)deviceToken
+{
+    // hand the token to Kii, install this device and listen to the leaderboard topic
+    // (push is only registered for once the SDK is up, so it's ready by now)
+    [Kii setAPNSDeviceToken:deviceToken];
+    _hasDeviceToken = TRUE;
+    
+    [self subscribeToLeaderboard];
+}
+
+- (void) subscribeToLeaderboard
+{
+    // without a token there's nothing to install yet - this is called again when it arrives
+    if(!_hasDeviceToken) {
+        return;
+    }
+    
+    // without a session this fails, and we're called again after the player logs in
+    [[CloudSession sharedSession] authenticateWithBlock:^(NSError *error) {
+        if(error != nil) {
+            return;
+        }
+        
+        [KiiPushInstallation installWithBlock:^(KiiPushInstallation *installation, NSError *error) {
+            if(error == nil) {
+                [[LeaderboardCache sharedCache] subscribe];
+            }
+        }];
+    }];
+}
+
+- (void)application:(UIApplication *)application didReceiveRemoteNotification:(NSDictionary *)userInfo
+{
+    // leaderboard deltas are applied to the local cache - no re-query needed
+    [[CloudSession sharedSession] whenReady:^{
+        KiiPushMessage *message = [KiiPushMessage messageFromAPNS:userInfo];
+        [[LeaderboardCache sharedCache] applyDelta:message.rawMessage];
+    }];
+}
 							
 - (void)applicationWillResignActive:(UIApplication *)application
 {
     // Sent when the application is about to move from active to inactive state. This can occur for certain types of temporary interruptions (such as an incoming phone call or SMS message) or when the user quits the application and it begins the transition to the background state.
     // Use this method to pause ongoing tasks, disable timers, and throttle down OpenGL ES frame rates. Games should use this method to pause the game.
+    
+    // stop the clock and keep the game on disk - there's little time here, and a snapshot takes microseconds
+    [(ViewController*)self.window.rootViewController saveGame];
 }
 
 - (void)applicationDidEnterBackground:(UIApplication *)application
@@ -58,6 +138,15 @@
 - (void)applicationDidBecomeActive:(UIApplication *)application
 {
     // Restart any tasks that were paused (or not yet started) while the application was inactive. If the application was previously in the background, optionally refresh the user interface.
+    
+    // check the session ahead of the next game over, and send any scores
+    // (and game summaries) that didn't make it last time
+    CloudSession *session = [CloudSession sharedSession];
+    [session whenReady:^{
+        [session refreshIfNeeded];
+        [[ScoreQueue sharedQueue] flush];
+        [[GameAnalytics sharedAnalytics] flush];
+    }];
 }
 
 - (void)applicationWillTerminate:(UIApplication *)application
@@ -16,6 +16,7 @@
 - (BlockNode*) initWithRow:(NSUInteger)row
                  andColumn:(NSUInteger)column
                  withColor:(UIColor*)color
-                   andSize:(CGSize)size;
+                   andSize:(CGSize)size
+                atPosition:(CGPoint)position;
 
 @end
@@ -15,6 +15,7 @@
                  andColumn:(NSUInteger)column
                  withColor:(UIColor*)color
                    andSize:(CGSize)size
+                atPosition:(CGPoint)position
 {
     
     self = [super initWithColor:color size:size];
@@ -30,12 +31,8 @@
         self.physicsBody.restitution = 0.f;
         self.physicsBody.allowsRotation = FALSE;
         
-        // generate the position of the block based on its row and column
-        CGFloat xPosition = (size.width / 2) + _column * size.width;
-        CGFloat yPosition = 480 + ( (size.height / 2) + _row * size.height );
-
-        // position the block within the scene
-        self.position = CGPointMake(xPosition, yPosition);
+        // position the block within the scene (the board layout works out where)
+        self.position = position;
         
     }
     
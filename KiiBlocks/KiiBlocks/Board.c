@@ -0,0 +1,564 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#include "Board.h"
+#include "BoardAdjacency.h"
+
+#include <string.h>
+
+// the tap path is written once, taking the board size as arguments, and
+// stamped out for the sizes the shipped modes use (see KBBoardTap) - with the
+// size a constant, the compiler unrolls and trims the row loops for each
+#define KB_KERNEL   static inline __attribute__((always_inline))
+
+// follow the parent links to the representative cell, halving the path as we go
+static inline int KBBoardFind(KBBoard *board, int index)
+{
+    while(board->label[index] != index) {
+        board->label[index] = board->label[board->label[index]];
+        index = board->label[index];
+    }
+    return index;
+}
+
+// join the clusters of two cells, keeping the lower index as the representative
+static inline void KBBoardUnion(KBBoard *board, int a, int b)
+{
+    int rootA = KBBoardFind(board, a);
+    int rootB = KBBoardFind(board, b);
+    
+    if(rootA < rootB) {
+        board->label[rootB] = rootA;
+    } else if(rootB < rootA) {
+        board->label[rootA] = rootB;
+    }
+}
+
+// rebuild the labeling for the 'dirty' cells in columns first..last. a cell is
+// dirty if it is in the band of columns that changed (bandFirst..bandLast) or
+// if its old cluster touched that band (its label is set in dirtyLabels).
+// every clean cell keeps its label: no clean cell can be next to a dirty cell
+// of the same color, or their clusters would have been dirty together
+KB_KERNEL void KBBoardRelabelKernel(KBBoard *board, int rows, int first, int last, int bandFirst, int bandLast, const uint64_t *dirtyLabels)
+{
+    uint64_t rowMask = (rows >= 64) ? ~0ULL : (1ULL << rows) - 1;
+    uint64_t dirty[BOARD_MAX_COLUMNS];
+    
+    // work out which cells need a new label (the whole band, plus whatever its
+    // clusters reached outside it)...
+    for(int col=first; col<=last; col++) {
+        if(col >= bandFirst && col <= bandLast) {
+            dirty[col] = rowMask;
+            continue;
+        }
+        
+        dirty[col] = 0;
+        for(int row=0; row<rows; row++) {
+            int label = board->label[BOARD_INDEX(col, row)];
+            dirty[col] |= ((dirtyLabels[label >> 6] >> (label & 63)) & 1) << row;
+        }
+    }
+    
+    // ...then make each of them its own cluster. the old clusters are going away,
+    // so stop counting the ones that could be busted
+    for(int col=first; col<=last; col++) {
+        for(uint64_t bits=dirty[col]; bits; bits &= bits - 1) {
+            int index = BOARD_INDEX(col, __builtin_ctzll(bits));
+            
+            if(board->label[index] == index && board->size[index] >= board->minBust) {
+                --board->movableClusters;
+            }
+            
+            board->label[index] = index;
+            board->size[index] = 0;
+            board->firstColumn[index] = (uint8_t)col;
+            board->lastColumn[index] = (uint8_t)col;
+        }
+    }
+    
+    // join every dirty cell with its same-colored neighbours above and to the right,
+    // using the adjacency masks so we only ever visit pairs that actually match
+    KBAdjacency adjacency;
+    KBAdjacencyUpdate(&adjacency, board, first, last);
+    
+    for(int col=first; col<=last; col++) {
+        
+        uint64_t up = dirty[col] & (dirty[col] >> 1) & adjacency.vertical[col];
+        while(up) {
+            int index = BOARD_INDEX(col, __builtin_ctzll(up));
+            KBBoardUnion(board, index, index+1);
+            up &= up - 1;
+        }
+        
+        if(col+1 <= last) {
+            uint64_t right = dirty[col] & dirty[col+1] & adjacency.horizontal[col];
+            while(right) {
+                int index = BOARD_INDEX(col, __builtin_ctzll(right));
+                KBBoardUnion(board, index, index+BOARD_MAX_ROWS);
+                right &= right - 1;
+            }
+        }
+    }
+    
+    // point every dirty cell straight at its representative and count it, noting
+    // each cluster as it grows big enough to bust. walking columns left to right
+    // means a cluster's first column is set first
+    for(int col=first; col<=last; col++) {
+        for(uint64_t bits=dirty[col]; bits; bits &= bits - 1) {
+            int index = BOARD_INDEX(col, __builtin_ctzll(bits));
+            int root = KBBoardFind(board, index);
+            
+            board->label[index] = root;
+            board->lastColumn[root] = (uint8_t)col;
+            
+            if(++board->size[root] == board->minBust) {
+                ++board->movableClusters;
+            }
+        }
+    }
+}
+
+// the color of the n-th block to drop into a column
+static inline uint8_t KBBoardRefillColor(const KBBoard *board, int column, uint32_t n)
+{
+    return KBRefillColor(board->refillSeed, board->colorCount, column, n);
+}
+
+// the hash key for how far along its stream a column is
+static inline uint64_t KBBoardStreamKey(const KBBoard *board, int column)
+{
+    return KBMix(board->refillSeed ^ ~((((uint64_t)column << 32) | board->dropped[column]) * 0xD6E8FEB86659FD93ULL));
+}
+
+// hash every cell on the board from scratch
+static uint64_t KBBoardHashAll(const KBBoard *board)
+{
+    uint64_t hash = 0;
+    
+    for(int col=0; col<board->columns; col++) {
+        hash ^= KBBoardStreamKey(board, col);
+    }
+    
+    for(int col=0; col<board->columns; col++) {
+        for(int row=0; row<board->rows; row++) {
+            int index = BOARD_INDEX(col, row);
+            hash ^= KBZobristKey(index, board->cells[index]);
+        }
+    }
+    
+    return hash;
+}
+
+// relabel every cell on the board from scratch
+static void KBBoardRelabelAll(KBBoard *board)
+{
+    uint64_t dirtyLabels[BOARD_MAX_CELLS / 64];
+    memset(dirtyLabels, 0, sizeof(dirtyLabels));
+    KBBoardRelabelKernel(board, board->rows, 0, board->columns-1, 0, board->columns-1, dirtyLabels);
+}
+
+// the n-th cell of a path that snakes up the first column, down the second and
+// so on - any two consecutive cells on it are neighbours
+static inline int KBBoardSnakeIndex(int rows, int n)
+{
+    int col = n / rows;
+    int row = n % rows;
+    
+    return BOARD_INDEX(col, (col & 1) ? rows-1 - row : row);
+}
+
+void KBBoardShuffleCells(uint8_t *cells, int columns, int rows, KBRandom *random)
+{
+    // fisher-yates over the cells, walking the snake so we can use plain counts
+    for(int n=columns*rows-1; n>0; n--) {
+        int a = KBBoardSnakeIndex(rows, n);
+        int b = KBBoardSnakeIndex(rows, KBRandomBelow(random, n+1));
+        
+        uint8_t color = cells[a];
+        cells[a] = cells[b];
+        cells[b] = color;
+    }
+}
+
+void KBBoardForceMove(uint8_t *cells, int columns, int rows, int minBust)
+{
+    int cellCount = columns * rows;
+    
+    // line up blocks of the most common color along the start of the snake
+    int counts[256] = { 0 };
+    int common = 0;
+    
+    for(int n=0; n<cellCount; n++) {
+        int color = cells[KBBoardSnakeIndex(rows, n)];
+        if(++counts[color] > counts[common]) {
+            common = color;
+        }
+    }
+    
+    // pull blocks of that color forward (or repaint, if there aren't enough of them)
+    int next = 0;
+    for(int n=0; n<minBust && n<cellCount; n++) {
+        int a = KBBoardSnakeIndex(rows, n);
+        
+        if(cells[a] == common) {
+            continue;
+        }
+        
+        if(next <= n) next = n+1;
+        while(next < cellCount && cells[KBBoardSnakeIndex(rows, next)] != common) {
+            ++next;
+        }
+        
+        if(next < cellCount) {
+            int b = KBBoardSnakeIndex(rows, next);
+            cells[b] = cells[a];
+        }
+        cells[a] = (uint8_t)common;
+    }
+}
+
+void KBBoardReshuffle(KBBoard *board)
+{
+    // a few plain shuffles almost always do it...
+    for(int attempt=0; attempt<BOARD_SHUFFLE_ATTEMPTS; attempt++) {
+        KBBoardShuffleCells(board->cells, board->columns, board->rows, &board->random);
+        KBBoardRelabelAll(board);
+        
+        if(KBBoardHasMove(board)) {
+            board->hash = KBBoardHashAll(board);
+            return;
+        }
+    }
+    
+    // ...otherwise build a move by hand
+    KBBoardForceMove(board->cells, board->columns, board->rows, board->minBust);
+    KBBoardRelabelAll(board);
+    board->hash = KBBoardHashAll(board);
+}
+
+void KBBoardInit(KBBoard *board, int columns, int rows, int colorCount, int minBust, uint64_t seed)
+{
+    memset(board, 0, sizeof(KBBoard));
+    
+    board->columns = columns;
+    board->rows = rows;
+    board->colorCount = colorCount;
+    board->minBust = minBust;
+    KBRandomSeed(&board->random, seed);
+    board->refillSeed = KBMix(seed ^ 0x5DEECE66DULL);
+    
+    // fill the board row by row, the same order the scene lays blocks out in
+    for(int row=0; row<rows; row++) {
+        for(int col=0; col<columns; col++) {
+            board->cells[BOARD_INDEX(col, row)] = (uint8_t)KBRandomBelow(&board->random, colorCount);
+        }
+    }
+    
+    // label and hash the whole board - every cell is dirty
+    KBBoardRelabelAll(board);
+    board->hash = KBBoardHashAll(board);
+    
+    // and never hand out a board that can't be played
+    if(!KBBoardHasMove(board)) {
+        KBBoardReshuffle(board);
+    }
+}
+
+void KBBoardCopy(KBBoard *to, const KBBoard *from)
+{
+    int used = from->columns * BOARD_MAX_ROWS;
+    
+    to->columns = from->columns;
+    to->rows = from->rows;
+    to->colorCount = from->colorCount;
+    to->minBust = from->minBust;
+    to->random = from->random;
+    to->refillSeed = from->refillSeed;
+    memcpy(to->dropped, from->dropped, from->columns * sizeof(uint32_t));
+    to->movableClusters = from->movableClusters;
+    to->hash = from->hash;
+    
+    // the cells take their padding along, so vector reads past the last column see the same thing
+    memcpy(to->cells, from->cells, used + BOARD_CELL_PADDING);
+    memcpy(to->label, from->label, used * sizeof(uint16_t));
+    memcpy(to->size, from->size, used * sizeof(uint16_t));
+    memcpy(to->firstColumn, from->firstColumn, used);
+    memcpy(to->lastColumn, from->lastColumn, used);
+}
+
+void KBBoardSetRefillSeed(KBBoard *board, uint64_t seed)
+{
+    board->refillSeed = seed;
+    memset(board->dropped, 0, sizeof(board->dropped));
+    board->hash = KBBoardHashAll(board);
+}
+
+// snapshots are little-endian whatever the device, so they can be replayed anywhere
+static inline uint8_t *KBPutLittleEndian(uint8_t *to, uint64_t value, int bytes)
+{
+    for(int i=0; i<bytes; i++) {
+        *to++ = (uint8_t)(value >> (8 * i));
+    }
+    return to;
+}
+
+static inline const uint8_t *KBGetLittleEndian(const uint8_t *from, uint64_t *value, int bytes)
+{
+    *value = 0;
+    for(int i=0; i<bytes; i++) {
+        *value |= (uint64_t)*from++ << (8 * i);
+    }
+    return from;
+}
+
+static inline size_t KBBoardSnapshotSize(int columns, int rows, int colorCount)
+{
+    int cells = columns * rows;
+    return 21 + 4 * columns + ((colorCount <= 16) ? (cells + 1) / 2 : cells);
+}
+
+size_t KBBoardSnapshot(const KBBoard *board, uint8_t *buffer, size_t capacity)
+{
+    size_t size = KBBoardSnapshotSize(board->columns, board->rows, board->colorCount);
+    if(capacity < size) {
+        return 0;
+    }
+    
+    uint8_t *at = buffer;
+    *at++ = BOARD_SNAPSHOT_VERSION;
+    *at++ = (uint8_t)board->columns;
+    *at++ = (uint8_t)board->rows;
+    *at++ = (uint8_t)board->colorCount;
+    *at++ = (uint8_t)board->minBust;
+    at = KBPutLittleEndian(at, board->random.state, 8);
+    at = KBPutLittleEndian(at, board->refillSeed, 8);
+    
+    for(int col=0; col<board->columns; col++) {
+        at = KBPutLittleEndian(at, board->dropped[col], 4);
+    }
+    
+    // the cells column by column, bottom row first - the same order they're kept in
+    int packed = (board->colorCount <= 16);
+    int n = 0;
+    for(int col=0; col<board->columns; col++) {
+        for(int row=0; row<board->rows; row++, n++) {
+            uint8_t color = board->cells[BOARD_INDEX(col, row)];
+            if(!packed) {
+                *at++ = color;
+            } else if(n & 1) {
+                *at++ |= (uint8_t)(color << 4);
+            } else {
+                *at = color;
+            }
+        }
+    }
+    
+    // an odd number of cells leaves the last byte half filled
+    if(packed && (n & 1)) {
+        at++;
+    }
+    
+    return (size_t)(at - buffer);
+}
+
+size_t KBBoardRestore(KBBoard *board, const uint8_t *buffer, size_t length)
+{
+    if(length < 21 || buffer[0] != BOARD_SNAPSHOT_VERSION) {
+        return 0;
+    }
+    
+    int columns = buffer[1];
+    int rows = buffer[2];
+    int colorCount = buffer[3];
+    int minBust = buffer[4];
+    
+    if(columns < 1 || columns > BOARD_MAX_COLUMNS || rows < 1 || rows > BOARD_MAX_ROWS || colorCount < 1 || minBust < 1) {
+        return 0;
+    }
+    
+    size_t size = KBBoardSnapshotSize(columns, rows, colorCount);
+    if(length < size) {
+        return 0;
+    }
+    
+    // check every color before touching the board, so a damaged snapshot leaves it as it was
+    const uint8_t *cells = buffer + 21 + 4 * columns;
+    int packed = (colorCount <= 16);
+    for(int n=0; n<columns*rows; n++) {
+        int color = packed ? ((cells[n / 2] >> (4 * (n & 1))) & 0xF) : cells[n];
+        if(color >= colorCount) {
+            return 0;
+        }
+    }
+    
+    memset(board, 0, sizeof(KBBoard));
+    board->columns = columns;
+    board->rows = rows;
+    board->colorCount = colorCount;
+    board->minBust = minBust;
+    
+    const uint8_t *at = buffer + 5;
+    uint64_t value;
+    at = KBGetLittleEndian(at, &value, 8);
+    KBRandomSeed(&board->random, value);
+    at = KBGetLittleEndian(at, &board->refillSeed, 8);
+    
+    for(int col=0; col<columns; col++) {
+        at = KBGetLittleEndian(at, &value, 4);
+        board->dropped[col] = (uint32_t)value;
+    }
+    
+    int n = 0;
+    for(int col=0; col<columns; col++) {
+        for(int row=0; row<rows; row++, n++) {
+            board->cells[BOARD_INDEX(col, row)] = packed ? ((cells[n / 2] >> (4 * (n & 1))) & 0xF) : cells[n];
+        }
+    }
+    
+    KBBoardRelabelAll(board);
+    board->hash = KBBoardHashAll(board);
+    
+    return size;
+}
+
+KB_KERNEL int KBBoardTapKernel(KBBoard *board, int columns, int rows, int column, int row, KBBoardChange *change)
+{
+    if(column < 0 || column >= columns || row < 0 || row >= rows) {
+        return 0;
+    }
+    
+    // a cluster too small to bust leaves the board untouched
+    int root = board->label[BOARD_INDEX(column, row)];
+    if(board->size[root] < board->minBust) {
+        return 0;
+    }
+    
+    int first = board->firstColumn[root];
+    int last = board->lastColumn[root];
+    
+    // every cell carrying the cluster's label is removed
+    uint64_t removed[BOARD_MAX_COLUMNS];
+    for(int col=first; col<=last; col++) {
+        removed[col] = 0;
+        for(int r=0; r<rows; r++) {
+            if(board->label[BOARD_INDEX(col, r)] == root) {
+                removed[col] |= 1ULL << r;
+            }
+        }
+    }
+    
+    // clusters touching the changed columns or their neighbours may split or
+    // merge, so they get relabeled - note them (and how far they reach) now,
+    // while the old labels still describe the board
+    int bandFirst = (first > 0) ? first-1 : 0;
+    int bandLast = (last < columns-1) ? last+1 : last;
+    int scanFirst = bandFirst;
+    int scanLast = bandLast;
+    
+    uint64_t dirtyLabels[BOARD_MAX_CELLS / 64];
+    memset(dirtyLabels, 0, sizeof(dirtyLabels));
+    
+    for(int col=bandFirst; col<=bandLast; col++) {
+        for(int r=0; r<rows; r++) {
+            int label = board->label[BOARD_INDEX(col, r)];
+            dirtyLabels[label >> 6] |= 1ULL << (label & 63);
+            
+            if(board->firstColumn[label] < scanFirst) scanFirst = board->firstColumn[label];
+            if(board->lastColumn[label] > scanLast) scanLast = board->lastColumn[label];
+        }
+    }
+    
+    // let the remaining blocks in each column fall, and refill from the top
+    int removedCount = 0;
+    
+    for(int col=first; col<=last; col++) {
+        uint8_t *cells = &board->cells[BOARD_INDEX(col, 0)];
+        int kept = 0;
+        
+        // everything from the lowest removed block up moves or changes, so
+        // those cells' keys come out of the hash now and go back in below
+        int lowest = removed[col] ? __builtin_ctzll(removed[col]) : rows;
+        for(int r=lowest; r<rows; r++) {
+            board->hash ^= KBZobristKey(BOARD_INDEX(col, r), cells[r]);
+        }
+        
+        for(int r=0; r<rows; r++) {
+            if(!((removed[col] >> r) & 1)) {
+                cells[kept++] = cells[r];
+            }
+        }
+        
+        // the column's stream moves along by however many blocks drop in
+        int spawned = rows - kept;
+        board->hash ^= KBBoardStreamKey(board, col);
+        
+        for(int r=kept; r<rows; r++) {
+            cells[r] = KBBoardRefillColor(board, col, board->dropped[col]++);
+        }
+        
+        board->hash ^= KBBoardStreamKey(board, col);
+        for(int r=lowest; r<rows; r++) {
+            board->hash ^= KBZobristKey(BOARD_INDEX(col, r), cells[r]);
+        }
+        
+        removedCount += spawned;
+        
+        if(change) {
+            change->removed[col] = removed[col];
+            change->spawned[col] = (uint8_t)spawned;
+        }
+    }
+    
+    KBBoardRelabelKernel(board, rows, scanFirst, scanLast, bandFirst, bandLast, dirtyLabels);
+    
+    // the refill may have left the board stuck
+    int reshuffled = !KBBoardHasMove(board);
+    if(reshuffled) {
+        KBBoardReshuffle(board);
+    }
+    
+    if(change) {
+        change->removedCount = removedCount;
+        change->firstColumn = first;
+        change->lastColumn = last;
+        change->reshuffled = reshuffled;
+    }
+    
+    return removedCount;
+}
+
+#define BOARD_TAP_KERNEL(COLUMNS, ROWS) \
+    static int KBBoardTap_##COLUMNS##x##ROWS(KBBoard *board, int column, int row, KBBoardChange *change) \
+        { return KBBoardTapKernel(board, COLUMNS, ROWS, column, row, change); }
+
+// the sizes of the modes in GameModes.json
+BOARD_TAP_KERNEL(6, 7)
+BOARD_TAP_KERNEL(8, 8)
+BOARD_TAP_KERNEL(12, 16)
+
+int KBBoardTap(KBBoard *board, int column, int row, KBBoardChange *change)
+{
+    // a couple of compares picks the specialized path - anything else takes the generic one
+    switch((board->columns << 8) | board->rows) {
+        case (6 << 8) | 7:      return KBBoardTap_6x7(board, column, row, change);
+        case (8 << 8) | 8:      return KBBoardTap_8x8(board, column, row, change);
+        case (12 << 8) | 16:    return KBBoardTap_12x16(board, column, row, change);
+        default:                return KBBoardTapKernel(board, board->columns, board->rows, column, row, change);
+    }
+}
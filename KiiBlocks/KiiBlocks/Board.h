@@ -0,0 +1,232 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#ifndef KiiBlocks_Board_h
+#define KiiBlocks_Board_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the logical game board - the rules of the game without any of the
+// SpriteKit parts, so it can also be run headless (hints, solvers, replays)
+
+// the largest board we support in either direction
+#define BOARD_MAX_COLUMNS   64
+#define BOARD_MAX_ROWS      64
+#define BOARD_MAX_CELLS     (BOARD_MAX_COLUMNS * BOARD_MAX_ROWS)
+
+// the cell array is padded by this much, so vector code can read a whole
+// register past the last column without leaving the board
+#define BOARD_CELL_PADDING  32
+
+// cells are stored column by column, bottom row first, so a whole column is
+// contiguous in memory and gravity only ever moves cells within a column
+#define BOARD_INDEX(column, row)    ((column) * BOARD_MAX_ROWS + (row))
+
+// a small, fast and fully deterministic random number generator (xorshift64*),
+// so the same seed always produces the same board and the same refills
+typedef struct {
+    uint64_t state;
+} KBRandom;
+
+static inline void KBRandomSeed(KBRandom *random, uint64_t seed)
+{
+    // the state must never be zero
+    random->state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+static inline uint32_t KBRandomNext(KBRandom *random)
+{
+    random->state ^= random->state >> 12;
+    random->state ^= random->state << 25;
+    random->state ^= random->state >> 27;
+    return (uint32_t)((random->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// a number in [0, limit)
+static inline uint32_t KBRandomBelow(KBRandom *random, uint32_t limit)
+{
+    return (uint32_t)(((uint64_t)KBRandomNext(random) * limit) >> 32);
+}
+
+// scrambles a number into an unrelated-looking one (the splitmix64 finalizer)
+static inline uint64_t KBMix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// zobrist hashing: every (cell, color) pair has its own random-looking key,
+// and a board's hash is all of its cells' keys xor'ed together. changing a
+// cell is then just xor'ing its old key out and its new key in. the keys are
+// mixed up from the cell and color on the fly rather than kept in a table
+static inline uint64_t KBZobristKey(int index, int color)
+{
+    return KBMix((((uint64_t)index << 8) | (uint64_t)color) * 0x9E3779B97F4A7C15ULL);
+}
+
+// the color of the n-th block to drop into a column, for a given refill seed
+static inline uint8_t KBRefillColor(uint64_t refillSeed, int colorCount, int column, uint32_t n)
+{
+    uint64_t x = KBMix(refillSeed ^ (((uint64_t)column << 32) | n) * 0x9E3779B97F4A7C15ULL);
+    return (uint8_t)(((x >> 32) * (uint64_t)colorCount) >> 32);
+}
+
+// how many plain shuffles a reshuffle tries before building a move by hand
+#define BOARD_SHUFFLE_ATTEMPTS  4
+
+typedef struct {
+    int columns;
+    int rows;
+    int colorCount;
+    int minBust;
+    
+    // drives the starting blocks and reshuffles
+    KBRandom random;
+    
+    // every column has its own endless stream of blocks to drop in: the n-th
+    // block to fall into a column only depends on this seed, the column and n.
+    // so clearing two clusters in either order ends up with the same board
+    uint64_t refillSeed;
+    uint32_t dropped[BOARD_MAX_COLUMNS];
+    
+    // the color of every cell
+    uint8_t cells[BOARD_MAX_CELLS + BOARD_CELL_PADDING];
+    
+    // connected-component labeling: every cell points at the representative
+    // cell of its cluster, and the representative holds the cluster's size and
+    // the range of columns it covers. kept up to date after every clear
+    uint16_t label[BOARD_MAX_CELLS];
+    uint16_t size[BOARD_MAX_CELLS];
+    uint8_t firstColumn[BOARD_MAX_CELLS];
+    uint8_t lastColumn[BOARD_MAX_CELLS];
+    
+    // how many clusters are big enough to bust. kept up to date with the
+    // labels, so telling whether the board is stuck costs nothing
+    int movableClusters;
+    
+    // the zobrist hash of the cells and of how far along each column's stream
+    // is, updated with every clear and refill
+    uint64_t hash;
+} KBBoard;
+
+// what changed on the board because of a tap
+typedef struct {
+    
+    // the number of blocks removed
+    int removedCount;
+    
+    // for each column, a bit for every row (as numbered before the tap) that was removed
+    uint64_t removed[BOARD_MAX_COLUMNS];
+    
+    // for each column, how many new blocks were dropped on top. they fill the
+    // top rows of the column and their colors can be read from the board
+    uint8_t spawned[BOARD_MAX_COLUMNS];
+    
+    // the range of columns that changed
+    int firstColumn;
+    int lastColumn;
+    
+    // set if the board was left without a move and had to be reshuffled -
+    // every cell may have a new color
+    int reshuffled;
+} KBBoardChange;
+
+// fill a board with random blocks from the given seed. the board always
+// starts out with at least one move
+void KBBoardInit(KBBoard *board, int columns, int rows, int colorCount, int minBust, uint64_t seed);
+
+// copy a board - only the columns in use, so small boards copy cheaply
+void KBBoardCopy(KBBoard *to, const KBBoard *from);
+
+// identifies the blocks on the board and the ones that will drop in next, so
+// two boards with the same hash play out the same from here on
+static inline uint64_t KBBoardHash(const KBBoard *board)
+{
+    return board->hash;
+}
+
+// snapshots hold everything needed to carry on playing a board: its size and
+// rules, where its random numbers and its columns' streams of blocks are, and
+// the color of every cell (packed two to a byte when there are 16 colors or
+// fewer). a 6x7 board takes 66 bytes, a 12x16 one 165. labels and the hash are
+// worked out again on restore, so they're not stored
+#define BOARD_SNAPSHOT_VERSION      1
+#define BOARD_SNAPSHOT_MAX_BYTES    (21 + 4 * BOARD_MAX_COLUMNS + BOARD_MAX_CELLS)
+
+// write a board's snapshot into buffer. returns the number of bytes written,
+// or 0 if the buffer is too small
+size_t KBBoardSnapshot(const KBBoard *board, uint8_t *buffer, size_t capacity);
+
+// rebuild a board from a snapshot, exactly as it was. returns the number of
+// bytes read, or 0 if the snapshot is damaged or from another version (the
+// board is left alone then)
+size_t KBBoardRestore(KBBoard *board, const uint8_t *buffer, size_t length);
+
+// switch the board over to different streams of blocks to drop in, starting
+// from their beginning (used to try out made-up futures on a copy)
+void KBBoardSetRefillSeed(KBBoard *board, uint64_t seed);
+
+// true if any cluster on the board can be busted
+static inline int KBBoardHasMove(const KBBoard *board)
+{
+    return board->movableClusters > 0;
+}
+
+// shuffle the blocks around so there is at least one move again. driven by
+// the board's own random numbers, so a replay reshuffles the same way
+void KBBoardReshuffle(KBBoard *board);
+
+// the two halves of a reshuffle, working on cells laid out like the board's.
+// shared with the packed board, so both reshuffle exactly the same way
+void KBBoardShuffleCells(uint8_t *cells, int columns, int rows, KBRandom *random);
+void KBBoardForceMove(uint8_t *cells, int columns, int rows, int minBust);
+
+static inline int KBBoardColorAt(const KBBoard *board, int column, int row)
+{
+    return board->cells[BOARD_INDEX(column, row)];
+}
+
+// how many blocks of a color are on the board
+static inline int KBBoardColorCount(const KBBoard *board, int color)
+{
+    int count = 0;
+    for(int c=0; c<board->columns; c++) {
+        const uint8_t *cells = &board->cells[BOARD_INDEX(c, 0)];
+        for(int r=0; r<board->rows; r++) {
+            count += (cells[r] == color);
+        }
+    }
+    return count;
+}
+
+// the size of the cluster a cell belongs to - a constant time lookup
+static inline int KBBoardClusterSize(const KBBoard *board, int column, int row)
+{
+    return board->size[board->label[BOARD_INDEX(column, row)]];
+}
+
+// tap a cell: if its cluster is big enough it is removed, the columns fall
+// and fresh blocks are dropped in on top (and if that leaves no moves, the
+// board is reshuffled). returns the number of blocks removed (0 if the tap
+// did nothing) and describes the change if asked
+int KBBoardTap(KBBoard *board, int column, int row, KBBoardChange *change);
+
+#endif
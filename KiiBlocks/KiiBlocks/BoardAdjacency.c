@@ -0,0 +1,113 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#include "BoardAdjacency.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BOARD_ADJACENCY_NEON
+#endif
+
+// compare 64 cells against another 64 cells, one bit per matching pair.
+// 'b' may be unaligned - the vertical masks compare a column with itself
+// shifted up by one cell
+static inline uint64_t KBAdjacencyCompare(const uint8_t *a, const uint8_t *b)
+{
+#if defined(__AVX2__)
+    
+    uint32_t low = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)a),
+                                                                    _mm256_loadu_si256((const __m256i*)b)));
+    uint32_t high = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a+32)),
+                                                                     _mm256_loadu_si256((const __m256i*)(b+32))));
+    return (uint64_t)low | ((uint64_t)high << 32);
+    
+#elif defined(__SSE2__)
+    
+    uint64_t mask = 0;
+    for(int i=0; i<64; i+=16) {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a+i)),
+                                       _mm_loadu_si128((const __m128i*)(b+i)));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(equal) << i;
+    }
+    return mask;
+    
+#elif defined(BOARD_ADJACENCY_NEON)
+    
+    // neon has no movemask: weight each lane by its bit and add the lanes up
+    static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t weights = vld1q_u8(bits);
+    
+    uint64_t mask = 0;
+    for(int i=0; i<64; i+=16) {
+        uint8x16_t equal = vandq_u8(vceqq_u8(vld1q_u8(a+i), vld1q_u8(b+i)), weights);
+        uint8x8_t sum = vpadd_u8(vget_low_u8(equal), vget_high_u8(equal));
+        sum = vpadd_u8(sum, sum);
+        sum = vpadd_u8(sum, sum);
+        mask |= (uint64_t)vget_lane_u16(vreinterpret_u16_u8(sum), 0) << i;
+    }
+    return mask;
+    
+#else
+    
+    uint64_t mask = 0;
+    for(int i=0; i<64; i++) {
+        mask |= (uint64_t)(a[i] == b[i]) << i;
+    }
+    return mask;
+    
+#endif
+}
+
+const char *KBAdjacencyKernel(void)
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#elif defined(BOARD_ADJACENCY_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+void KBAdjacencyUpdate(KBAdjacency *adjacency, const KBBoard *board, int first, int last)
+{
+    // only the rows the board actually has count
+    uint64_t rowMask = (board->rows >= 64) ? ~0ULL : (1ULL << board->rows) - 1;
+    
+    for(int col=first; col<=last; col++) {
+        const uint8_t *cells = &board->cells[BOARD_INDEX(col, 0)];
+        
+        // the top row has nothing above it
+        adjacency->vertical[col] = KBAdjacencyCompare(cells, cells+1) & (rowMask >> 1);
+        
+        // and the last column has nothing to its right
+        if(col+1 < board->columns) {
+            adjacency->horizontal[col] = KBAdjacencyCompare(cells, cells+BOARD_MAX_ROWS) & rowMask;
+        } else {
+            adjacency->horizontal[col] = 0;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#ifndef KiiBlocks_BoardAdjacency_h
+#define KiiBlocks_BoardAdjacency_h
+
+#include "Board.h"
+
+// same-color adjacency for a whole board, one bit per cell. this is the inner
+// loop of everything that looks at the board as a whole (labeling, move
+// detection, hints, solvers), so it is vectorized: every column is 64 bytes,
+// compared 16 (SSE2/NEON) or 32 (AVX2) cells at a time
+
+typedef struct {
+    
+    // for each column, bit r is set if cell (column, r) matches cell (column+1, r)
+    uint64_t horizontal[BOARD_MAX_COLUMNS];
+    
+    // for each column, bit r is set if cell (column, r) matches cell (column, r+1)
+    uint64_t vertical[BOARD_MAX_COLUMNS];
+} KBAdjacency;
+
+// the name of the kernel compiled in ("avx2", "sse2", "neon" or "scalar")
+const char *KBAdjacencyKernel(void);
+
+// compute the adjacency masks for columns first..last. the rest of the
+// masks are left alone, so a caller can refresh only what changed
+void KBAdjacencyUpdate(KBAdjacency *adjacency, const KBBoard *board, int first, int last);
+
+#endif
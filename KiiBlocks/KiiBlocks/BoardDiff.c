@@ -0,0 +1,130 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#include "BoardDiff.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static KBBoardDiff *KBBoardDiffCreate(const KBQueuedTap *tap, uint16_t generation, int outcome, uint32_t opCapacity)
+{
+    KBBoardDiff *diff = malloc(sizeof(KBBoardDiff) + opCapacity * sizeof(KBDiffOp));
+    memset(diff, 0, sizeof(KBBoardDiff));
+    
+    diff->micros = tap->micros;
+    diff->column = tap->column;
+    diff->row = tap->row;
+    diff->generation = generation;
+    diff->outcome = (uint8_t)outcome;
+    
+    return diff;
+}
+
+static inline void KBBoardDiffAdd(KBBoardDiff *diff, int kind, int column, int row, int value)
+{
+    KBDiffOp *op = &diff->ops[diff->opCount++];
+    op->kind = (uint8_t)kind;
+    op->column = (uint8_t)column;
+    op->row = (uint8_t)row;
+    op->value = (uint8_t)value;
+}
+
+KBBoardDiff *KBBoardDiffForTap(KBBoard *board, const KBQueuedTap *tap, uint16_t generation, uint32_t *sequence)
+{
+    int column = tap->column;
+    int row = tap->row;
+    
+    // the screen was showing another board, or the block has gone since
+    if(tap->generation != generation || column >= board->columns || row >= board->rows ||
+       board->dropped[column] != tap->columnStamp) {
+        return KBBoardDiffCreate(tap, generation, KB_DIFF_REJECTED, 0);
+    }
+    
+    int color = KBBoardColorAt(board, column, row);
+    int clusterSize = KBBoardClusterSize(board, column, row);
+    
+    if(clusterSize < board->minBust) {
+        KBBoardDiff *diff = KBBoardDiffCreate(tap, generation, KB_DIFF_MISSED, 0);
+        diff->color = (uint8_t)color;
+        diff->clusterSize = (uint16_t)clusterSize;
+        diff->sequence = *sequence;
+        return diff;
+    }
+    
+    // before the blocks go - the refill may well bring the color back
+    int colorCleared = (KBBoardColorCount(board, color) == clusterSize);
+    
+    KBBoardChange change;
+    KBBoardTap(board, column, row, &change);
+    
+    // every cell of a changed column may show up once as a move plus one
+    // remove or spawn - and a reshuffle recolors every cell on top of that
+    int changedColumns = change.lastColumn - change.firstColumn + 1;
+    uint32_t capacity = 2 * changedColumns * board->rows;
+    if(change.reshuffled) {
+        capacity += board->columns * board->rows;
+    }
+    
+    KBBoardDiff *diff = KBBoardDiffCreate(tap, generation, KB_DIFF_CLEARED, capacity);
+    diff->color = (uint8_t)color;
+    diff->clusterSize = (uint16_t)clusterSize;
+    diff->sequence = ++*sequence;
+    diff->removedCount = (uint16_t)change.removedCount;
+    diff->reshuffled = (uint8_t)change.reshuffled;
+    diff->colorCleared = (uint8_t)colorCleared;
+    
+    for(int c=change.firstColumn; c<=change.lastColumn; c++) {
+        uint64_t removed = change.removed[c];
+        
+        // removes top down, so a list indexed by row stays valid as they're taken out
+        for(int r=board->rows-1; r>=0; r--) {
+            if((removed >> r) & 1) {
+                KBBoardDiffAdd(diff, KB_DIFF_REMOVE, c, r, 0);
+            }
+        }
+        
+        // the blocks left keep their order and close up from the bottom
+        int to = 0;
+        for(int r=0; r<board->rows; r++) {
+            if((removed >> r) & 1) {
+                continue;
+            }
+            if(r != to) {
+                KBBoardDiffAdd(diff, KB_DIFF_MOVE, c, r, to);
+            }
+            ++to;
+        }
+        
+        // and new blocks fill the top rows
+        for(int r=board->rows-change.spawned[c]; r<board->rows; r++) {
+            KBBoardDiffAdd(diff, KB_DIFF_SPAWN, c, r, KBBoardColorAt(board, c, r));
+        }
+    }
+    
+    // a reshuffle can change any cell's color
+    if(change.reshuffled) {
+        for(int c=0; c<board->columns; c++) {
+            for(int r=0; r<board->rows; r++) {
+                KBBoardDiffAdd(diff, KB_DIFF_RECOLOR, c, r, KBBoardColorAt(board, c, r));
+            }
+        }
+    }
+    
+    return diff;
+}
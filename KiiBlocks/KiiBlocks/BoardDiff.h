@@ -0,0 +1,133 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#ifndef KiiBlocks_BoardDiff_h
+#define KiiBlocks_BoardDiff_h
+
+#include "Board.h"
+#include "TapQueue.h"
+
+// what a tap did to the board, as a short list of cell changes the screen can
+// apply without knowing the rules. the board itself lives with whoever
+// resolves the taps (the simulation queue in the app) - the scene only ever
+// sees these
+
+// how a queued tap turned out
+typedef enum {
+    KB_DIFF_REJECTED,       // the block under the finger was gone by the time the tap came up
+    KB_DIFF_MISSED,         // the cluster was too small to bust - nothing changed
+    KB_DIFF_CLEARED         // the cluster was busted
+} KBDiffOutcome;
+
+typedef enum {
+    KB_DIFF_REMOVE,         // the block at (column, row) is gone
+    KB_DIFF_MOVE,           // the block at (column, row) fell to row 'value'
+    KB_DIFF_SPAWN,          // a new block of color 'value' drops in at (column, row)
+    KB_DIFF_RECOLOR         // the block at (column, row) is now color 'value' (a reshuffle)
+} KBDiffOpKind;
+
+// rows are numbered as they were before the tap for removes and moves, and as
+// they are after it for spawns and recolors. per column, removes come first
+// (top down), then moves (bottom up), then spawns (bottom up) - applying them
+// in order never needs to look ahead
+typedef struct {
+    uint8_t kind;
+    uint8_t column;
+    uint8_t row;
+    uint8_t value;
+} KBDiffOp;
+
+typedef struct {
+    
+    // the tap this came from
+    uint64_t micros;
+    uint8_t column;
+    uint8_t row;
+    uint16_t generation;
+    
+    uint8_t outcome;
+    
+    // the color and size of the tapped cluster (0 if rejected)
+    uint8_t color;
+    uint16_t clusterSize;
+    
+    // how many taps have changed this board so far, this one included
+    uint32_t sequence;
+    
+    uint16_t removedCount;
+    uint8_t reshuffled;
+    
+    // set if the cluster was every block of its color on the board
+    uint8_t colorCleared;
+    
+    uint32_t opCount;
+    KBDiffOp ops[];
+} KBBoardDiff;
+
+// resolve a queued tap on the board, and describe what happened. taps from
+// another generation of board, or on a column that has changed since the
+// finger came down, are rejected. the diff is malloc'ed - free() it when done
+KBBoardDiff *KBBoardDiffForTap(KBBoard *board, const KBQueuedTap *tap, uint16_t generation, uint32_t *sequence);
+
+// must be a power of two so the indices can wrap with a mask
+#define BOARD_DIFF_QUEUE_SIZE   64
+
+// a lock-free single-producer / single-consumer queue of diffs, on its way
+// from the simulation to the screen (the same scheme as the tap queue)
+typedef struct {
+    KBBoardDiff *diffs[BOARD_DIFF_QUEUE_SIZE];
+    
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+} KBBoardDiffQueue;
+
+// nothing is ever dropped - a producer finding the queue full holds on to its taps until there's room
+static inline int KBBoardDiffQueueFull(KBBoardDiffQueue *queue)
+{
+    return queue->head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == BOARD_DIFF_QUEUE_SIZE;
+}
+
+static inline int KBBoardDiffQueuePush(KBBoardDiffQueue *queue, KBBoardDiff *diff)
+{
+    if(KBBoardDiffQueueFull(queue)) {
+        return 0;
+    }
+    
+    uint32_t head = queue->head;
+    queue->diffs[head & (BOARD_DIFF_QUEUE_SIZE-1)] = diff;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// the oldest diff, or NULL if there are none
+static inline KBBoardDiff *KBBoardDiffQueuePop(KBBoardDiffQueue *queue)
+{
+    uint32_t tail = queue->tail;
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    
+    if(tail == head) {
+        return NULL;
+    }
+    
+    KBBoardDiff *diff = queue->diffs[tail & (BOARD_DIFF_QUEUE_SIZE-1)];
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return diff;
+}
+
+#endif
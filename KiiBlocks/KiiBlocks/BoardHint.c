@@ -0,0 +1,274 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#include "BoardHint.h"
+#include "Clock.h"
+
+#include <stdlib.h>
+
+// values go in the table as fixed point, in 1/16ths of a block
+#define HINT_TABLE_SCALE    16.f
+
+typedef struct {
+    int index;
+    int size;
+} KBHintCandidate;
+
+// everything a search carries around
+typedef struct {
+    uint64_t deadline;
+    int timedOut;
+    
+    KBTranspositionTable *table;
+    
+    // the board as it is, once for every made-up future
+    KBBoard *worlds[HINT_LOOKAHEAD_SAMPLES];
+    
+    // a board to tap on for every level of lookahead (the candidates themselves
+    // are tapped on the first one)
+    KBBoard *scratch[HINT_MAX_LOOKAHEAD + 1];
+    
+    int positions;
+    int tableHits;
+} KBHintSearch;
+
+// biggest clusters first, then by position so the order never depends on the sort
+static int KBHintCompare(const void *a, const void *b)
+{
+    const KBHintCandidate *first = a;
+    const KBHintCandidate *second = b;
+    
+    if(first->size != second->size) {
+        return second->size - first->size;
+    }
+    return first->index - second->index;
+}
+
+// the biggest few clusters that can be busted, biggest first. returns how many were found
+static int KBHintTopClusters(const KBBoard *board, KBHintCandidate *top, int limit)
+{
+    int count = 0;
+    
+    for(int col=0; col<board->columns; col++) {
+        for(int row=0; row<board->rows; row++) {
+            int index = BOARD_INDEX(col, row);
+            int size = board->size[index];
+            
+            if(board->label[index] != index || size < board->minBust) {
+                continue;
+            }
+            
+            // insert it in order, dropping the smallest if we're full
+            int slot = (count < limit) ? count++ : limit;
+            while(slot > 0 && top[slot-1].size < size) {
+                if(slot < limit) {
+                    top[slot] = top[slot-1];
+                }
+                --slot;
+            }
+            if(slot < limit) {
+                top[slot].index = index;
+                top[slot].size = size;
+            }
+        }
+    }
+    
+    return count;
+}
+
+// tap a cluster on a copy of the board
+static inline void KBHintTap(KBBoard *scratch, const KBBoard *board, int index)
+{
+    KBBoardCopy(scratch, board);
+    KBBoardTap(scratch, index / BOARD_MAX_ROWS, index % BOARD_MAX_ROWS, NULL);
+}
+
+// the most the next 'depth' taps can remove from this board. the board
+// carries its made-up future along, so this is a plain search where every
+// refill is known. positions reached again - clearing two clusters in either
+// order, say - come straight out of the table
+static float KBHintValue(KBHintSearch *search, const KBBoard *board, int depth)
+{
+    ++search->positions;
+    
+    KBTranspositionTable *table = search->table;
+    
+    uint32_t stored;
+    if(table && KBTranspositionTableProbe(table, KBBoardHash(board), depth, &stored)) {
+        ++search->tableHits;
+        return stored / HINT_TABLE_SCALE;
+    }
+    
+    KBHintCandidate top[HINT_BRANCHING];
+    int count = KBHintTopClusters(board, top, (depth > 1) ? HINT_BRANCHING : 1);
+    
+    float best = 0.f;
+    
+    // one tap to go: the biggest cluster is all there is to it
+    if(depth == 1 || count == 0) {
+        best = (count > 0) ? top[0].size : 0.f;
+    } else {
+        for(int i=0; i<count; i++) {
+            if(KBClockMicros() >= search->deadline) {
+                search->timedOut = 1;
+                return 0.f;
+            }
+            
+            KBHintTap(search->scratch[depth], board, top[i].index);
+            float value = top[i].size + KBHintValue(search, search->scratch[depth], depth-1);
+            
+            if(search->timedOut) {
+                return 0.f;
+            }
+            
+            if(value > best) {
+                best = value;
+            }
+        }
+    }
+    
+    if(table) {
+        KBTranspositionTableStore(table, KBBoardHash(board), depth, (uint32_t)(best * HINT_TABLE_SCALE + 0.5f));
+    }
+    
+    return best;
+}
+
+int KBBoardHint(const KBBoard *board, uint64_t budgetMicros, int lookahead, KBTranspositionTable *table, KBHint *hint)
+{
+    KBHintSearch search;
+    search.deadline = KBClockMicros() + budgetMicros;
+    search.timedOut = 0;
+    search.table = table;
+    search.positions = 0;
+    search.tableHits = 0;
+    
+    if(lookahead > HINT_MAX_LOOKAHEAD) {
+        lookahead = HINT_MAX_LOOKAHEAD;
+    }
+    
+    hint->column = -1;
+    hint->row = -1;
+    hint->size = 0;
+    hint->score = 0.f;
+    hint->candidates = 0;
+    hint->evaluated = 0;
+    hint->positions = 0;
+    hint->tableHits = 0;
+    
+    // every cluster's representative cell knows its size, so the candidates are
+    // just the representatives of the clusters big enough to bust
+    KBHintCandidate *candidates = malloc(sizeof(KBHintCandidate) * board->columns * board->rows);
+    int count = 0;
+    
+    for(int col=0; col<board->columns; col++) {
+        for(int row=0; row<board->rows; row++) {
+            int index = BOARD_INDEX(col, row);
+            if(board->label[index] == index && board->size[index] >= board->minBust) {
+                candidates[count].index = index;
+                candidates[count].size = board->size[index];
+                ++count;
+            }
+        }
+    }
+    
+    if(count == 0) {
+        free(candidates);
+        return 0;
+    }
+    
+    qsort(candidates, count, sizeof(KBHintCandidate), KBHintCompare);
+    hint->candidates = count;
+    
+    // without lookahead (or if time runs out before anything is rated) the biggest cluster wins
+    int best = 0;
+    float bestScore = candidates[0].size;
+    hint->evaluated = 1;
+    
+    if(lookahead > 0) {
+        
+        // tapping changes the board, so work on scratch copies
+        for(int level=0; level<=lookahead; level++) {
+            search.scratch[level] = malloc(sizeof(KBBoard));
+        }
+        
+        // the real refills are unknown to the player, so try a few made-up
+        // futures instead. they are the same for every hint, so positions
+        // stay comparable (and in the table) from one hint to the next
+        for(int world=0; world<HINT_LOOKAHEAD_SAMPLES; world++) {
+            search.worlds[world] = malloc(sizeof(KBBoard));
+            KBBoardCopy(search.worlds[world], board);
+            KBBoardSetRefillSeed(search.worlds[world], KBMix(0x9E3779B97F4A7C15ULL * (world+1)));
+        }
+        
+        bestScore = -1.f;
+        hint->evaluated = 0;
+        
+        for(int i=0; i<count && !search.timedOut; i++) {
+            
+            // average what follows over the made-up futures
+            float total = 0.f;
+            for(int world=0; world<HINT_LOOKAHEAD_SAMPLES && !search.timedOut; world++) {
+                if(KBClockMicros() >= search.deadline) {
+                    search.timedOut = 1;
+                    break;
+                }
+                
+                KBHintTap(search.scratch[0], search.worlds[world], candidates[i].index);
+                total += KBHintValue(&search, search.scratch[0], lookahead);
+            }
+            
+            // a half-rated candidate is no use
+            if(search.timedOut) {
+                break;
+            }
+            
+            float score = candidates[i].size + total / HINT_LOOKAHEAD_SAMPLES;
+            if(score > bestScore) {
+                bestScore = score;
+                best = i;
+            }
+            
+            ++hint->evaluated;
+        }
+        
+        for(int level=0; level<=lookahead; level++) {
+            free(search.scratch[level]);
+        }
+        for(int world=0; world<HINT_LOOKAHEAD_SAMPLES; world++) {
+            free(search.worlds[world]);
+        }
+        
+        if(hint->evaluated == 0) {
+            best = 0;
+            bestScore = candidates[0].size;
+        }
+    }
+    
+    hint->column = candidates[best].index / BOARD_MAX_ROWS;
+    hint->row = candidates[best].index % BOARD_MAX_ROWS;
+    hint->size = candidates[best].size;
+    hint->score = bestScore;
+    hint->positions = search.positions;
+    hint->tableHits = search.tableHits;
+    
+    free(candidates);
+    return 1;
+}
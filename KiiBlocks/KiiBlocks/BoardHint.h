@@ -0,0 +1,69 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#ifndef KiiBlocks_BoardHint_h
+#define KiiBlocks_BoardHint_h
+
+#include "Board.h"
+#include "TranspositionTable.h"
+
+// finds the best cluster to tap. pure C on top of the board rules, so it can
+// run on a background queue in the app or headless in tools/benchmarks
+
+// how many made-up futures (refills) each candidate is tried against
+#define HINT_LOOKAHEAD_SAMPLES  4
+
+// past the candidate itself, only the biggest few clusters are followed
+#define HINT_BRANCHING          4
+
+// the deepest lookahead we support
+#define HINT_MAX_LOOKAHEAD      4
+
+typedef struct {
+    
+    // a cell in the suggested cluster (-1 if the board has no move)
+    int column;
+    int row;
+    
+    // how many blocks tapping it removes right away
+    int size;
+    
+    // what we rated it - the size, plus the expected best follow-up when looking ahead
+    float score;
+    
+    // how many clusters could be tapped, and how many of them we got to rate
+    // before the budget ran out (the biggest ones are always rated first)
+    int candidates;
+    int evaluated;
+    
+    // how many positions were looked at, and how many of those the table already knew
+    int positions;
+    int tableHits;
+} KBHint;
+
+// pick the best cluster on the board within roughly budgetMicros microseconds.
+// with a lookahead of n, each candidate is also tapped on a copy of the board
+// over a few sampled refills, and rated by the best the next n taps can do
+// from there. positions already worked out are looked up in the table (which
+// may be NULL, and may be shared with other threads). the board is not
+// changed. returns TRUE if there was anything to suggest
+int KBBoardHint(const KBBoard *board, uint64_t budgetMicros, int lookahead, KBTranspositionTable *table, KBHint *hint);
+
+#endif
@@ -0,0 +1,56 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+
+// the height of the floor strip along the bottom of the scene, which also
+// holds the score, hint and timer labels
+#define BOARD_FOOTER_HEIGHT 40
+
+// works out where everything on the board goes for a given scene size and
+// grid, so the same code lays out a 6x7 board on a phone and a big board on a
+// tablet. every cell's position is worked out once up front - placing a block
+// is then a table lookup
+@interface BoardLayout : NSObject
+
+@property (nonatomic, readonly) CGSize sceneSize;
+@property (nonatomic, readonly) int columns;
+@property (nonatomic, readonly) int rows;
+
+// the width and height of a block - the largest whole number of points that
+// fits the whole grid in the scene above the footer
+@property (nonatomic, readonly) CGFloat cellSize;
+
+// the bottom left corner of the grid (it is centered horizontally)
+@property (nonatomic, readonly) CGPoint origin;
+
+// how high new blocks start out before falling into place - just above the
+// top of the scene
+@property (nonatomic, readonly) CGFloat spawnHeight;
+
+- (id) initWithSceneSize:(CGSize)size columns:(int)columns rows:(int)rows;
+
+// the center of a cell once the blocks have settled
+- (CGPoint) positionForColumn:(int)column row:(int)row;
+
+// the center of a block that is about to drop into a cell
+- (CGPoint) spawnPositionForColumn:(int)column row:(int)row;
+
+@end
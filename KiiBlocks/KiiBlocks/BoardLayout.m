@@ -0,0 +1,90 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "BoardLayout.h"
+
+@interface BoardLayout() {
+    
+    // rest and spawn positions, indexed by column * rows + row
+    CGPoint *_positions;
+    CGPoint *_spawnPositions;
+}
+
+@end
+
+@implementation BoardLayout
+
+- (id) initWithSceneSize:(CGSize)size columns:(int)columns rows:(int)rows
+{
+    self = [super init];
+    
+    if(self) {
+        
+        _sceneSize = size;
+        _columns = columns;
+        _rows = rows;
+        
+        // as big as the blocks can be while the whole grid still fits. whole
+        // points only, so the blocks line up on pixels
+        CGFloat byWidth = size.width / columns;
+        CGFloat byHeight = (size.height - BOARD_FOOTER_HEIGHT) / rows;
+        _cellSize = floorf(MIN(byWidth, byHeight));
+        
+        // center the grid left to right, and sit it on the floor
+        _origin = CGPointMake(floorf((size.width - _cellSize * columns) / 2), BOARD_FOOTER_HEIGHT);
+        _spawnHeight = size.height;
+        
+        // work out every position up front
+        _positions = malloc(sizeof(CGPoint) * columns * rows);
+        _spawnPositions = malloc(sizeof(CGPoint) * columns * rows);
+        
+        for(int col=0; col<columns; col++) {
+            
+            CGFloat x = _origin.x + (_cellSize / 2) + col * _cellSize;
+            
+            for(int row=0; row<rows; row++) {
+                
+                CGFloat y = (_cellSize / 2) + row * _cellSize;
+                
+                _positions[col * rows + row] = CGPointMake(x, _origin.y + y);
+                _spawnPositions[col * rows + row] = CGPointMake(x, _spawnHeight + y);
+            }
+        }
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    free(_positions);
+    free(_spawnPositions);
+}
+
+- (CGPoint) positionForColumn:(int)column row:(int)row
+{
+    return _positions[column * _rows + row];
+}
+
+- (CGPoint) spawnPositionForColumn:(int)column row:(int)row
+{
+    return _spawnPositions[column * _rows + row];
+}
+
+@end
@@ -0,0 +1,74 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+// how often the stored session is checked with the server. the SDK doesn't
+// tell us when a token expires, so an expired one is only noticed when the
+// server turns it down - at one of these checks, or when a score is sent
+#define SESSION_VERIFY_INTERVAL     (6 * 60 * 60)
+
+// starts the Kii SDK and restores the player's session on a background
+// queue, so the board is up and playable before the cloud is. anything that
+// talks to Kii goes through whenReady: rather than assuming it's been started.
+//
+// the session (access token and who it belongs to) is kept in the keychain,
+// so a player logs in once and not on every launch. it is restored in the
+// background at launch and checked again now and then, so by the time a game
+// is over we already know whether the score can go straight up
+@interface CloudSession : NSObject
+
+// TRUE once the SDK has been started
+@property (nonatomic, readonly, getter=isReady) BOOL ready;
+
+// TRUE if we have a session the server hasn't turned down. it may not have
+// been restored yet - authenticateWithBlock: sees to that
+@property (nonatomic, readonly) BOOL hasSession;
+
+// who the session belongs to, known from the keychain before the SDK is up
+@property (nonatomic, readonly) NSString *username;
+@property (nonatomic, readonly) NSString *userID;
+
++ (CloudSession*) sharedSession;
+
+// start the SDK with our app's id and key - call once, at launch
+- (void) startWithAppID:(NSString*)appID andKey:(NSString*)appKey;
+
+// run a block on the main queue once the SDK is ready (right away if it already is)
+- (void) whenReady:(void (^)(void))block;
+
+// make sure the SDK is logged in with our session, restoring it from the
+// stored token if need be. the block gets an error if there's no session or
+// it couldn't be restored (and the session is dropped if it was turned down)
+- (void) authenticateWithBlock:(void (^)(NSError *error))block;
+
+// keep the SDK's current user's session - call after a login
+- (void) saveSession;
+
+// forget the session, here and in the keychain
+- (void) invalidateSession;
+
+// check the session with the server in the background, if it hasn't been in
+// a while. called whenever the app becomes active
+- (void) refreshIfNeeded;
+
+// TRUE if an error from the server means our session is no good
++ (BOOL) isUnauthorizedError:(NSError*)error;
+
+@end
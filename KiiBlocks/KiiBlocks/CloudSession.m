@@ -0,0 +1,294 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "CloudSession.h"
+#import "Instrumentation.h"
+
+#import <Security/Security.h>
+
+// where the session lives in the keychain
+static NSString * const CloudSessionService = @"com.kii.KiiBlocks.session";
+static NSString * const CloudSessionAccount = @"session";
+
+// the stored session as a dictionary (token, username, userID, and the
+// verifiedAt time in seconds since 1970), or nil if there is none
+static NSDictionary *keychainSession(void)
+{
+    NSDictionary *query = @{(__bridge id)kSecClass: (__bridge id)kSecClassGenericPassword,
+                            (__bridge id)kSecAttrService: CloudSessionService,
+                            (__bridge id)kSecAttrAccount: CloudSessionAccount,
+                            (__bridge id)kSecReturnData: @YES,
+                            (__bridge id)kSecMatchLimit: (__bridge id)kSecMatchLimitOne};
+    
+    CFTypeRef data = NULL;
+    if(SecItemCopyMatching((__bridge CFDictionaryRef)query, &data) != errSecSuccess) {
+        return nil;
+    }
+    
+    NSDictionary *session = [NSPropertyListSerialization propertyListWithData:(__bridge_transfer NSData*)data
+                                                                      options:NSPropertyListImmutable
+                                                                       format:NULL
+                                                                        error:nil];
+    return [session isKindOfClass:[NSDictionary class]] ? session : nil;
+}
+
+static void setKeychainSession(NSDictionary *session)
+{
+    NSDictionary *query = @{(__bridge id)kSecClass: (__bridge id)kSecClassGenericPassword,
+                            (__bridge id)kSecAttrService: CloudSessionService,
+                            (__bridge id)kSecAttrAccount: CloudSessionAccount};
+    SecItemDelete((__bridge CFDictionaryRef)query);
+    
+    if(session == nil) {
+        return;
+    }
+    
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:session
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0
+                                                               error:nil];
+    
+    // readable in the background once the device has been unlocked, so a
+    // refresh can run whenever we get the time - but never leaves the device
+    NSMutableDictionary *item = [query mutableCopy];
+    [item setObject:data forKey:(__bridge id)kSecValueData];
+    [item setObject:(__bridge id)kSecAttrAccessibleAfterFirstUnlockThisDeviceOnly forKey:(__bridge id)kSecAttrAccessible];
+    
+    OSStatus status = SecItemAdd((__bridge CFDictionaryRef)item, NULL);
+    if(status != errSecSuccess) {
+        NSLog(@"Unable to store the session: %d", (int)status);
+    }
+}
+
+@interface CloudSession() {
+    
+    // entered until the SDK is started, so blocks can wait on it
+    dispatch_group_t _startup;
+    
+    // the stored session (see keychainSession)
+    NSDictionary *_session;
+    
+    // blocks waiting on a token login that's under way
+    NSMutableArray *_authenticating;
+    
+    BOOL _refreshing;
+}
+
+@end
+
+@implementation CloudSession
+
++ (CloudSession*) sharedSession
+{
+    static CloudSession *sharedSession = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedSession = [[CloudSession alloc] init];
+    });
+    return sharedSession;
+}
+
++ (BOOL) isUnauthorizedError:(NSError*)error
+{
+    // the SDK passes the server's status and error code along with the error
+    NSDictionary *info = error.userInfo;
+    NSString *code = [[info objectForKey:@"server_code"] description];
+    
+    return [[info objectForKey:@"http_status"] integerValue] == 401 ||
+           [code isEqualToString:@"WRONG_TOKEN"] ||
+           [code isEqualToString:@"INVALID_ACCESS_TOKEN"] ||
+           [code isEqualToString:@"ACCESS_TOKEN_EXPIRED"];
+}
+
+- (id) init
+{
+    self = [super init];
+    
+    if(self) {
+        _startup = dispatch_group_create();
+        dispatch_group_enter(_startup);
+    }
+    
+    return self;
+}
+
+- (BOOL) hasSession
+{
+    return _session != nil;
+}
+
+- (NSString*) username
+{
+    return [_session objectForKey:@"username"];
+}
+
+- (NSString*) userID
+{
+    return [_session objectForKey:@"userID"];
+}
+
+- (void) startWithAppID:(NSString*)appID andKey:(NSString*)appKey
+{
+    // starting the SDK reads its settings and the stored session from disk -
+    // none of which the first game needs, so it happens off the main thread
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        [Kii beginWithID:appID
+                  andKey:appKey
+                 andSite:kiiSiteUS];
+        [[Instrumentation sharedInstrumentation] markStartupPhase:@"cloudStarted"];
+        
+        NSDictionary *session = keychainSession();
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            _session = session;
+            _ready = TRUE;
+            dispatch_group_leave(_startup);
+            
+            // log back in with the stored token while the player is busy playing
+            [self authenticateWithBlock:^(NSError *error) {
+                [[Instrumentation sharedInstrumentation] markStartupPhase:@"sessionRestored"];
+                NSLog(@"Cloud ready (%@)", (error == nil) ? self.username : @"not logged in");
+                
+                [self refreshIfNeeded];
+            }];
+        });
+    });
+}
+
+- (void) whenReady:(void (^)(void))block
+{
+    if(_ready && [NSThread isMainThread]) {
+        block();
+        return;
+    }
+    
+    dispatch_group_notify(_startup, dispatch_get_main_queue(), block);
+}
+
+- (void) authenticateWithBlock:(void (^)(NSError *error))block
+{
+    [self whenReady:^{
+        
+        if(_session == nil) {
+            if(block) {
+                block([NSError errorWithDomain:@"CloudSession" code:401 userInfo:@{NSLocalizedDescriptionKey: @"Not logged in"}]);
+            }
+            return;
+        }
+        
+        // already logged in with this session
+        if([KiiUser loggedIn] && [[KiiUser currentUser].accessToken isEqualToString:[_session objectForKey:@"token"]]) {
+            if(block) {
+                block(nil);
+            }
+            return;
+        }
+        
+        // a login is already under way - wait for it rather than start another
+        BOOL started = (_authenticating != nil);
+        if(!started) {
+            _authenticating = [NSMutableArray array];
+        }
+        if(block) {
+            [_authenticating addObject:[block copy]];
+        }
+        if(started) {
+            return;
+        }
+        
+        [KiiUser authenticateWithToken:[_session objectForKey:@"token"]
+                              andBlock:^(KiiUser *user, NSError *error) {
+            
+            // the server doesn't know the token any more. when it's just
+            // the network, we keep the session and try again later
+            if(error != nil && [CloudSession isUnauthorizedError:error]) {
+                NSLog(@"Stored session was turned down: %@", error);
+                [self invalidateSession];
+            }
+            
+            NSArray *blocks = _authenticating;
+            _authenticating = nil;
+            for(void (^waiting)(NSError*) in blocks) {
+                waiting(error);
+            }
+        }];
+    }];
+}
+
+- (void) saveSession
+{
+    KiiUser *user = [KiiUser currentUser];
+    if(user.accessToken == nil) {
+        return;
+    }
+    
+    NSMutableDictionary *session = [NSMutableDictionary dictionary];
+    [session setObject:user.accessToken forKey:@"token"];
+    [session setObject:user.username forKey:@"username"];
+    [session setObject:user.uuid forKey:@"userID"];
+    [session setObject:@([[NSDate date] timeIntervalSince1970]) forKey:@"verifiedAt"];
+    
+    _session = session;
+    setKeychainSession(session);
+}
+
+- (void) invalidateSession
+{
+    _session = nil;
+    setKeychainSession(nil);
+}
+
+- (void) refreshIfNeeded
+{
+    if(_session == nil || _refreshing) {
+        return;
+    }
+    
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    if(now - [[_session objectForKey:@"verifiedAt"] doubleValue] <= SESSION_VERIFY_INTERVAL) {
+        return;
+    }
+    
+    // re-reading the user from the server tells us whether the token still
+    // holds, and picks up the new one if the server has renewed it. if it no
+    // longer holds, the player is asked to log in at the next game over -
+    // not in the middle of sending a score
+    _refreshing = TRUE;
+    [self authenticateWithBlock:^(NSError *error) {
+        
+        if(error != nil) {
+            _refreshing = FALSE;
+            return;
+        }
+        
+        [[KiiUser currentUser] refreshWithBlock:^(KiiUser *user, NSError *error) {
+            _refreshing = FALSE;
+            
+            if(error == nil) {
+                [self saveSession];
+            } else if([CloudSession isUnauthorizedError:error]) {
+                NSLog(@"Session expired: %@", error);
+                [self invalidateSession];
+            }
+        }];
+    }];
+}
+
+@end
@@ -0,0 +1,46 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+// gathers gameplay analytics for Kii Cloud. taps are recorded into a
+// lock-free ring on the game thread, folded into histograms on a background
+// queue, and a single compact summary object is saved per game session
+@interface GameAnalytics : NSObject
+
++ (GameAnalytics*) sharedAnalytics;
+
+// start collecting a new game session
+- (void) beginSession;
+
+// record a tap on a block - cheap enough to call from the middle of a touch handler
+- (void) recordTapWithClusterSize:(NSUInteger)clusterSize
+                            color:(NSUInteger)color
+                          removed:(BOOL)removed
+                 secondsSinceStart:(float)seconds;
+
+// finish the session and upload its summary to the 'analytics' bucket, along
+// with how many taps the game threw away before they got as far as the board.
+// summaries made while nobody is logged in are kept until somebody is
+- (void) endSessionWithScore:(NSUInteger)score rejectedTaps:(NSUInteger)rejectedTaps;
+
+// send the summaries that are still waiting, if there's a session to send them with
+- (void) flush;
+
+@end
@@ -0,0 +1,260 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "GameAnalytics.h"
+#import "CloudSession.h"
+#import "TapEventRing.h"
+#import "Histogram.h"
+
+// the most block colors we keep individual counts for
+#define ANALYTICS_MAX_COLORS    8
+
+// how often the background queue drains the ring
+#define ANALYTICS_DRAIN_INTERVAL    0.5
+
+// the most game summaries kept while nobody is logged in - the oldest go first
+#define ANALYTICS_MAX_UNSENT        50
+
+@interface GameAnalytics() {
+    
+    // written by the game thread, read by the analytics queue
+    KBTapEventRing _ring;
+    
+    // everything below is only touched on the analytics queue
+    dispatch_queue_t _queue;
+    dispatch_source_t _drainTimer;
+    
+    KBHistogram _clusterSizes;
+    KBHistogram _tapTimes;
+    uint32_t _colorTaps[ANALYTICS_MAX_COLORS];
+    uint32_t _taps;
+    uint32_t _busts;
+    uint32_t _droppedAtStart;
+    NSDate *_sessionStart;
+    
+    // summaries waiting for a session to go up with, mirrored in
+    // analytics.plist - only touched on the main thread
+    NSMutableArray *_unsent;
+    NSString *_unsentPath;
+    BOOL _sending;
+}
+
+@end
+
+@implementation GameAnalytics
+
++ (GameAnalytics*) sharedAnalytics
+{
+    static GameAnalytics *sharedAnalytics = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedAnalytics = [[GameAnalytics alloc] init];
+    });
+    return sharedAnalytics;
+}
+
+- (id) init
+{
+    self = [super init];
+    
+    if(self) {
+        _queue = dispatch_queue_create("com.kii.blocks.analytics", DISPATCH_QUEUE_SERIAL);
+        
+        // taps can come in before the first session begins - they're drained
+        // into these and thrown away when it does
+        KBHistogramInit(&_clusterSizes, 1, 1);
+        KBHistogramInit(&_tapTimes, 0, 1);
+        
+        NSString *documents = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, TRUE) lastObject];
+        _unsentPath = [documents stringByAppendingPathComponent:@"analytics.plist"];
+        _unsent = [NSMutableArray arrayWithContentsOfFile:_unsentPath];
+        if(_unsent == nil) {
+            _unsent = [NSMutableArray array];
+        }
+        
+        // periodically move whatever the game thread recorded into our histograms
+        _drainTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+        dispatch_source_set_timer(_drainTimer, DISPATCH_TIME_NOW,
+                                  (uint64_t)(ANALYTICS_DRAIN_INTERVAL * NSEC_PER_SEC),
+                                  (uint64_t)(0.1 * NSEC_PER_SEC));
+        
+        __weak GameAnalytics *weakSelf = self;
+        dispatch_source_set_event_handler(_drainTimer, ^{
+            [weakSelf drain];
+        });
+        dispatch_resume(_drainTimer);
+    }
+    
+    return self;
+}
+
+// pull every pending event off the ring - only called on the analytics queue
+- (void) drain
+{
+    KBTapEvent event;
+    
+    while(KBTapEventRingPop(&_ring, &event)) {
+        
+        ++_taps;
+        KBHistogramAdd(&_clusterSizes, event.clusterSize);
+        KBHistogramAdd(&_tapTimes, event.secondsSinceStart);
+        
+        if(event.removed) {
+            ++_busts;
+        }
+        if(event.color < ANALYTICS_MAX_COLORS) {
+            ++_colorTaps[event.color];
+        }
+    }
+}
+
+- (void) beginSession
+{
+    dispatch_async(_queue, ^{
+        
+        // throw away anything left over from before this session
+        [self drain];
+        
+        KBHistogramInit(&_clusterSizes, 1, 1);
+        KBHistogramInit(&_tapTimes, 0, 1);
+        memset(_colorTaps, 0, sizeof(_colorTaps));
+        _taps = 0;
+        _busts = 0;
+        _droppedAtStart = _ring.dropped;
+        _sessionStart = [NSDate date];
+    });
+}
+
+- (void) recordTapWithClusterSize:(NSUInteger)clusterSize
+                            color:(NSUInteger)color
+                          removed:(BOOL)removed
+                 secondsSinceStart:(float)seconds
+{
+    // the hot path: one struct copy and an atomic store, no locks, no allocation
+    KBTapEvent event = {
+        .clusterSize = (uint16_t)MIN(clusterSize, UINT16_MAX),
+        .color = (uint8_t)MIN(color, UINT8_MAX),
+        .removed = removed ? 1 : 0,
+        .secondsSinceStart = seconds
+    };
+    KBTapEventRingPush(&_ring, event);
+}
+
+// turn a histogram into something we can store in a KiiObject
+- (NSArray*) bucketsOf:(KBHistogram*)histogram
+{
+    // trim trailing empty buckets to keep the object small
+    int last = HISTOGRAM_BUCKETS - 1;
+    while(last >= 0 && histogram->buckets[last] == 0) --last;
+    
+    NSMutableArray *buckets = [NSMutableArray arrayWithCapacity:last + 1];
+    for(int i=0; i<=last; i++) {
+        [buckets addObject:@(histogram->buckets[i])];
+    }
+    return buckets;
+}
+
+- (void) endSessionWithScore:(NSUInteger)score rejectedTaps:(NSUInteger)rejectedTaps
+{
+    dispatch_async(_queue, ^{
+        
+        // pick up the last few taps of the game
+        [self drain];
+        
+        // nothing worth reporting if the session never started
+        if(_sessionStart == nil || _taps == 0) {
+            return;
+        }
+        
+        NSMutableArray *colors = [NSMutableArray arrayWithCapacity:ANALYTICS_MAX_COLORS];
+        for(int i=0; i<ANALYTICS_MAX_COLORS; i++) {
+            [colors addObject:@(_colorTaps[i])];
+        }
+        
+        NSDictionary *summary = @{@"score": @(score),
+                                  @"taps": @(_taps),
+                                  @"busts": @(_busts),
+                                  @"dropped": @(_ring.dropped - _droppedAtStart),
+                                  @"rejected": @(rejectedTaps),
+                                  @"duration": @([[NSDate date] timeIntervalSinceDate:_sessionStart]),
+                                  @"clusterSizes": [self bucketsOf:&_clusterSizes],
+                                  @"tapSeconds": [self bucketsOf:&_tapTimes],
+                                  @"colorTaps": colors};
+        _sessionStart = nil;
+        
+        // kept until there's a session to send it with - a new player only
+        // logs in at the end of their first game, after its summary is made
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [_unsent addObject:summary];
+            if(_unsent.count > ANALYTICS_MAX_UNSENT) {
+                [_unsent removeObjectAtIndex:0];
+            }
+            [_unsent writeToFile:_unsentPath atomically:TRUE];
+            
+            [self flush];
+        });
+    });
+}
+
+- (void) flush
+{
+    if(_sending || _unsent.count == 0) {
+        return;
+    }
+    _sending = TRUE;
+    
+    [[CloudSession sharedSession] authenticateWithBlock:^(NSError *error) {
+        if(error != nil) {
+            _sending = FALSE;
+            return;
+        }
+        [self sendNext];
+    }];
+}
+
+// send the oldest summary, and the rest after it one at a time -
+// one small object per session rather than one per event
+- (void) sendNext
+{
+    NSDictionary *summary = [_unsent firstObject];
+    if(summary == nil) {
+        _sending = FALSE;
+        return;
+    }
+    
+    KiiObject *object = [[Kii bucketWithName:@"analytics"] createObject];
+    for(NSString *key in summary) {
+        [object setObject:[summary objectForKey:key] forKey:key];
+    }
+    [object setObject:[CloudSession sharedSession].username forKey:@"username"];
+    
+    [object saveWithBlock:^(KiiObject *object, NSError *error) {
+        if(error != nil) {
+            NSLog(@"Unable to save analytics: %@", error);
+            _sending = FALSE;
+            return;
+        }
+        
+        [_unsent removeObjectIdenticalTo:summary];
+        [_unsent writeToFile:_unsentPath atomically:TRUE];
+        [self sendNext];
+    }];
+}
+
+@end
@@ -0,0 +1,93 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+#import "Scoring.h"
+
+// the most block colors a mode can use (the scene has a color for each)
+#define GAME_MODE_MAX_COLORS    8
+
+// posted on the main thread when a different mode has been fetched from the
+// cloud - it is used from the next game on
+extern NSString * const GameModeDidChangeNotification;
+
+// the rules of a game: board size, colors, timing and scoring. modes are
+// plain data, so we can try out variants (A/B tests) by changing a cloud
+// object instead of shipping a new binary
+@interface GameMode : NSObject
+
+@property (nonatomic, readonly) NSString *name;
+
+@property (nonatomic, readonly) int columns;
+@property (nonatomic, readonly) int rows;
+
+// how many blocks have to be connected before they can be busted
+@property (nonatomic, readonly) int minBust;
+
+@property (nonatomic, readonly) int colorCount;
+
+// how long a game lasts, in seconds
+@property (nonatomic, readonly) NSTimeInterval timeLimit;
+
+// the points for busting a cluster of n blocks are scoring[n]. past the end
+// of the list, each extra block adds as much as the last step did. with no
+// list every block is worth a point
+@property (nonatomic, readonly) NSArray *scoring;
+
+// what a cluster of each color is worth, in percent of the above (100 for
+// colors past the end of the list)
+@property (nonatomic, readonly) NSArray *colorBonus;
+
+// clears no more than chainWindow seconds apart make a chain, and the n-th
+// clear of a chain is worth chain[n] percent (longer chains stay at the last
+// one). with no list there are no chains
+@property (nonatomic, readonly) NSArray *chain;
+@property (nonatomic, readonly) NSTimeInterval chainWindow;
+
+// extra points for busting every block of a color on the board in one go
+@property (nonatomic, readonly) NSUInteger colorClearBonus;
+
+// the original game: 6x7, four colors, pairs bust, five seconds
++ (GameMode*) classicMode;
+
+// the modes shipped in GameModes.json
++ (NSArray*) bundledModes;
+
+// the mode to play: the last one fetched from the cloud if there is one,
+// otherwise the first bundled mode
++ (GameMode*) currentMode;
+
+// build a mode from its JSON form - nil if anything is missing or out of range
++ (GameMode*) modeWithDictionary:(NSDictionary*)dictionary;
+
+// load a mode from a local JSON file
++ (GameMode*) modeWithContentsOfFile:(NSString*)path;
+
+// fetch the active modes from the 'modes' bucket and pick this player's
+// variant. the choice is stable per install, so a player stays in the same
+// group of an A/B test. it is saved locally and becomes the current mode
++ (void) fetchFromCloudWithBlock:(void (^)(GameMode *mode, NSError *error))block;
+
+- (NSDictionary*) dictionaryValue;
+
+// the scoring as the C core has it (see Scoring.h) - the app and the
+// validator build their tables from these
+- (void) getScoringRules:(KBScoringRules*)rules;
+
+@end
@@ -0,0 +1,282 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "GameMode.h"
+#import "Board.h"
+
+NSString * const GameModeDidChangeNotification = @"GameModeDidChangeNotification";
+
+// where the mode fetched from the cloud is kept between launches
+static NSString *savedModePath()
+{
+    NSString *documents = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, TRUE) lastObject];
+    return [documents stringByAppendingPathComponent:@"gamemode.json"];
+}
+
+// a list of non-negative numbers no longer than we can take, none bigger than
+// the C core can hold (or no list at all)
+static BOOL isNumberList(id list, NSUInteger maxCount, double maxValue)
+{
+    if(list == nil) {
+        return TRUE;
+    }
+    if(![list isKindOfClass:[NSArray class]] || [list count] > maxCount) {
+        return FALSE;
+    }
+    for(NSNumber *number in list) {
+        if(![number isKindOfClass:[NSNumber class]] || number.doubleValue < 0 || number.doubleValue > maxValue) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+@interface GameMode() {
+    KBScoringRules _rules;
+}
+
+@end
+
+@implementation GameMode
+
++ (GameMode*) classicMode
+{
+    return [GameMode modeWithDictionary:@{@"name": @"classic",
+                                          @"columns": @6,
+                                          @"rows": @7,
+                                          @"minBust": @2,
+                                          @"colors": @4,
+                                          @"timeLimit": @5.0}];
+}
+
++ (NSArray*) bundledModes
+{
+    static NSArray *modes = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        
+        NSMutableArray *loaded = [NSMutableArray array];
+        
+        NSString *path = [[NSBundle mainBundle] pathForResource:@"GameModes" ofType:@"json"];
+        NSData *data = (path != nil) ? [NSData dataWithContentsOfFile:path] : nil;
+        NSArray *list = (data != nil) ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+        
+        if([list isKindOfClass:[NSArray class]]) {
+            for(NSDictionary *dictionary in list) {
+                GameMode *mode = [GameMode modeWithDictionary:dictionary];
+                if(mode != nil) {
+                    [loaded addObject:mode];
+                }
+            }
+        }
+        
+        // we always have something to play
+        if(loaded.count == 0) {
+            [loaded addObject:[GameMode classicMode]];
+        }
+        
+        modes = loaded;
+    });
+    
+    return modes;
+}
+
++ (GameMode*) currentMode
+{
+    GameMode *mode = [GameMode modeWithContentsOfFile:savedModePath()];
+    
+    if(mode == nil) {
+        mode = [[GameMode bundledModes] objectAtIndex:0];
+    }
+    
+    return mode;
+}
+
++ (GameMode*) modeWithDictionary:(NSDictionary*)dictionary
+{
+    if(![dictionary isKindOfClass:[NSDictionary class]]) {
+        return nil;
+    }
+    
+    NSString *name = [dictionary objectForKey:@"name"];
+    NSNumber *columns = [dictionary objectForKey:@"columns"];
+    NSNumber *rows = [dictionary objectForKey:@"rows"];
+    NSNumber *minBust = [dictionary objectForKey:@"minBust"];
+    NSNumber *colors = [dictionary objectForKey:@"colors"];
+    NSNumber *timeLimit = [dictionary objectForKey:@"timeLimit"];
+    NSArray *scoring = [dictionary objectForKey:@"scoring"];
+    NSArray *colorBonus = [dictionary objectForKey:@"colorBonus"];
+    NSArray *chain = [dictionary objectForKey:@"chain"];
+    NSNumber *chainWindow = [dictionary objectForKey:@"chainWindow"];
+    NSNumber *colorClearBonus = [dictionary objectForKey:@"colorClearBonus"];
+    
+    if(![name isKindOfClass:[NSString class]] || ![columns isKindOfClass:[NSNumber class]]
+       || ![rows isKindOfClass:[NSNumber class]] || ![minBust isKindOfClass:[NSNumber class]]
+       || ![colors isKindOfClass:[NSNumber class]] || ![timeLimit isKindOfClass:[NSNumber class]]) {
+        return nil;
+    }
+    
+    // the board core has its limits, and the scene only has so many colors
+    if(columns.intValue < 1 || columns.intValue > BOARD_MAX_COLUMNS
+       || rows.intValue < 1 || rows.intValue > BOARD_MAX_ROWS
+       || minBust.intValue < 1 || minBust.intValue > columns.intValue * rows.intValue
+       || colors.intValue < 1 || colors.intValue > GAME_MODE_MAX_COLORS
+       || timeLimit.doubleValue <= 0) {
+        return nil;
+    }
+    
+    // the scoring has to fit the C core's tables - a value too big for its
+    // field would wrap around rather than fail
+    if(!isNumberList(scoring, SCORING_MAX_STEPS, UINT32_MAX)
+       || !isNumberList(colorBonus, GAME_MODE_MAX_COLORS, UINT16_MAX)
+       || !isNumberList(chain, SCORING_MAX_CHAIN, UINT16_MAX)
+       || (chainWindow != nil && (![chainWindow isKindOfClass:[NSNumber class]]
+                                  || chainWindow.doubleValue < 0 || chainWindow.doubleValue * 1000 > UINT32_MAX))
+       || (colorClearBonus != nil && (![colorClearBonus isKindOfClass:[NSNumber class]]
+                                      || colorClearBonus.doubleValue < 0 || colorClearBonus.doubleValue > UINT32_MAX))) {
+        return nil;
+    }
+    
+    GameMode *mode = [[GameMode alloc] init];
+    mode->_name = name;
+    mode->_columns = columns.intValue;
+    mode->_rows = rows.intValue;
+    mode->_minBust = minBust.intValue;
+    mode->_colorCount = colors.intValue;
+    mode->_timeLimit = timeLimit.doubleValue;
+    mode->_scoring = (scoring.count > 0) ? scoring : nil;
+    mode->_colorBonus = (colorBonus.count > 0) ? colorBonus : nil;
+    mode->_chain = (chain.count > 0) ? chain : nil;
+    // a window means nothing without a chain, and isn't saved without one -
+    // dropping it here keeps the rules (and so the mode replays are matched
+    // to) the same after the mode has been cached and read back
+    mode->_chainWindow = (mode->_chain != nil) ? chainWindow.doubleValue : 0;
+    mode->_colorClearBonus = colorClearBonus.unsignedIntegerValue;
+    
+    // work out the rules once, the same way the validator reads them from a replay
+    KBScoringRulesDefault(&mode->_rules);
+    mode->_rules.stepCount = (uint32_t)mode->_scoring.count;
+    for(NSUInteger i=0; i<mode->_scoring.count; i++) {
+        mode->_rules.steps[i] = [[mode->_scoring objectAtIndex:i] unsignedIntValue];
+    }
+    for(NSUInteger i=0; i<mode->_colorBonus.count; i++) {
+        mode->_rules.colorPercent[i] = [[mode->_colorBonus objectAtIndex:i] unsignedShortValue];
+    }
+    mode->_rules.chainWindowMillis = (uint32_t)(mode->_chainWindow * 1000);
+    mode->_rules.chainCount = (uint32_t)mode->_chain.count;
+    for(NSUInteger i=0; i<mode->_chain.count; i++) {
+        mode->_rules.chainPercent[i] = [[mode->_chain objectAtIndex:i] unsignedShortValue];
+    }
+    mode->_rules.colorClearBonus = (uint32_t)mode->_colorClearBonus;
+    
+    return mode;
+}
+
++ (GameMode*) modeWithContentsOfFile:(NSString*)path
+{
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    if(data == nil) {
+        return nil;
+    }
+    
+    return [GameMode modeWithDictionary:[NSJSONSerialization JSONObjectWithData:data options:0 error:nil]];
+}
+
++ (void) fetchFromCloudWithBlock:(void (^)(GameMode *mode, NSError *error))block
+{
+    KiiQuery *query = [KiiQuery queryWithClause:[KiiClause equals:@"active" value:[NSNumber numberWithBool:TRUE]]];
+    [query sortByAsc:@"name"];
+    
+    [[Kii bucketWithName:@"modes"] executeQuery:query
+                                      withBlock:^(KiiQuery *query, KiiBucket *bucket, NSArray *results, KiiQuery *nextQuery, NSError *error) {
+        
+        GameMode *mode = nil;
+        
+        if(error == nil && results.count > 0) {
+            
+            // every install rolls its variant once and keeps it
+            NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+            NSInteger variant = [defaults integerForKey:@"modeVariant"];
+            if(variant == 0) {
+                variant = 1 + arc4random_uniform(1 << 30);
+                [defaults setInteger:variant forKey:@"modeVariant"];
+                [defaults synchronize];
+            }
+            
+            KiiObject *object = [results objectAtIndex:variant % results.count];
+            
+            NSMutableDictionary *dictionary = [NSMutableDictionary dictionary];
+            for(NSString *key in @[@"name", @"columns", @"rows", @"minBust", @"colors", @"timeLimit", @"scoring",
+                                   @"colorBonus", @"chain", @"chainWindow", @"colorClearBonus"]) {
+                id value = [object getObjectForKey:key];
+                if(value != nil) {
+                    [dictionary setObject:value forKey:key];
+                }
+            }
+            
+            mode = [GameMode modeWithDictionary:dictionary];
+            
+            // keep it for the next game (and the next launch)
+            if(mode != nil) {
+                NSData *json = [NSJSONSerialization dataWithJSONObject:[mode dictionaryValue] options:0 error:nil];
+                NSData *saved = [NSData dataWithContentsOfFile:savedModePath()];
+                
+                if(![json isEqualToData:saved]) {
+                    [json writeToFile:savedModePath() atomically:TRUE];
+                    [[NSNotificationCenter defaultCenter] postNotificationName:GameModeDidChangeNotification object:mode];
+                }
+            }
+        }
+        
+        if(block) block(mode, error);
+    }];
+}
+
+- (NSDictionary*) dictionaryValue
+{
+    NSMutableDictionary *dictionary = [NSMutableDictionary dictionaryWithDictionary:@{@"name": _name,
+                                                                                      @"columns": @(_columns),
+                                                                                      @"rows": @(_rows),
+                                                                                      @"minBust": @(_minBust),
+                                                                                      @"colors": @(_colorCount),
+                                                                                      @"timeLimit": @(_timeLimit)}];
+    if(_scoring != nil) {
+        [dictionary setObject:_scoring forKey:@"scoring"];
+    }
+    if(_colorBonus != nil) {
+        [dictionary setObject:_colorBonus forKey:@"colorBonus"];
+    }
+    if(_chain != nil) {
+        [dictionary setObject:_chain forKey:@"chain"];
+        [dictionary setObject:@(_chainWindow) forKey:@"chainWindow"];
+    }
+    if(_colorClearBonus > 0) {
+        [dictionary setObject:@(_colorClearBonus) forKey:@"colorClearBonus"];
+    }
+    
+    return dictionary;
+}
+
+- (void) getScoringRules:(KBScoringRules*)rules
+{
+    *rules = _rules;
+}
+
+@end
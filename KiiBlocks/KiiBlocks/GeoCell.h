@@ -0,0 +1,38 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+// how many geohash characters make up a regional leaderboard cell. 4
+// characters is roughly 40km x 20km (matches GEOCELL_PRECISION on the server)
+#define GEOCELL_PRECISION   4
+
+// maps locations to the geohash cells regional leaderboards are keyed by
+@interface GeoCell : NSObject
+
+// the geohash of the cell containing a location
++ (NSString*) cellForLatitude:(double)latitude
+                 andLongitude:(double)longitude;
+
+// the cell containing a location plus its eight neighbours, so players near
+// the edge of a cell still see the people just across the border
++ (NSArray*) cellsAroundLatitude:(double)latitude
+                    andLongitude:(double)longitude;
+
+@end
@@ -0,0 +1,85 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "GeoCell.h"
+
+static const char GeohashAlphabet[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+@implementation GeoCell
+
++ (NSString*) cellForLatitude:(double)latitude
+                 andLongitude:(double)longitude
+{
+    int bits = GEOCELL_PRECISION * 5;
+    int lonBits = (bits + 1) / 2;
+    int latBits = bits / 2;
+    
+    // work out the integer cell indices first - interleaving their bits gives
+    // the same string as the classic bisection algorithm
+    int64_t x = (int64_t)floor((longitude + 180.0) / 360.0 * (double)(1LL << lonBits));
+    int64_t y = (int64_t)floor((latitude + 90.0) / 180.0 * (double)(1LL << latBits));
+    x = MIN(MAX(x, 0), (1LL << lonBits) - 1);
+    y = MIN(MAX(y, 0), (1LL << latBits) - 1);
+    
+    char hash[GEOCELL_PRECISION + 1];
+    int value = 0;
+    int xBit = lonBits - 1, yBit = latBits - 1;
+    
+    for(int i=0; i<bits; i++) {
+        
+        // even bits come from the longitude, odd bits from the latitude
+        int bit = (i % 2 == 0) ? (int)((x >> xBit--) & 1) : (int)((y >> yBit--) & 1);
+        value = (value << 1) | bit;
+        
+        if(i % 5 == 4) {
+            hash[i / 5] = GeohashAlphabet[value];
+            value = 0;
+        }
+    }
+    hash[GEOCELL_PRECISION] = '\0';
+    
+    return [NSString stringWithUTF8String:hash];
+}
+
++ (NSArray*) cellsAroundLatitude:(double)latitude
+                    andLongitude:(double)longitude
+{
+    int bits = GEOCELL_PRECISION * 5;
+    double latStep = 180.0 / (double)(1LL << (bits / 2));
+    double lonStep = 360.0 / (double)(1LL << ((bits + 1) / 2));
+    
+    NSMutableArray *cells = [NSMutableArray arrayWithCapacity:9];
+    
+    // step one cell in each direction, wrapping around the date line
+    for(int dy=-1; dy<=1; dy++) {
+        for(int dx=-1; dx<=1; dx++) {
+            double lat = MIN(MAX(latitude + dy * latStep, -90.0), 89.999999);
+            double lon = fmod(longitude + dx * lonStep + 540.0, 360.0) - 180.0;
+            
+            NSString *cell = [GeoCell cellForLatitude:lat andLongitude:lon];
+            if(![cells containsObject:cell]) {
+                [cells addObject:cell];
+            }
+        }
+    }
+    
+    return cells;
+}
+
+@end
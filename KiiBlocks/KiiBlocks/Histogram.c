@@ -0,0 +1,106 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#include "Histogram.h"
+
+#include <math.h>
+#include <string.h>
+
+void KBHistogramInit(KBHistogram *histogram, double min, double width)
+{
+    memset(histogram, 0, sizeof(KBHistogram));
+    histogram->min = min;
+    histogram->width = width;
+}
+
+void KBHistogramInitExponential(KBHistogram *histogram, double first, double growth)
+{
+    memset(histogram, 0, sizeof(KBHistogram));
+    histogram->min = first;
+    histogram->growth = growth;
+}
+
+double KBHistogramBucketLimit(const KBHistogram *histogram, int bucket)
+{
+    if(histogram->growth > 0) {
+        return histogram->min * pow(histogram->growth, bucket);
+    }
+    return histogram->min + (bucket + 1) * histogram->width;
+}
+
+void KBHistogramAdd(KBHistogram *histogram, double value)
+{
+    // work out which bucket the value falls into, clamping at both ends
+    double position;
+    if(histogram->growth > 0) {
+        position = (value < histogram->min) ? 0 : 1 + log(value / histogram->min) / log(histogram->growth);
+    } else if(histogram->width > 0) {
+        position = (value - histogram->min) / histogram->width;
+    } else {
+        // a histogram that was never set up (or has no width) counts everything in the first bucket
+        position = 0;
+    }
+    
+    // written so that a NaN lands in the first bucket rather than becoming an index
+    int bucket = !(position >= 0) ? 0 : (position >= HISTOGRAM_BUCKETS ? HISTOGRAM_BUCKETS-1 : (int)position);
+    
+    ++histogram->buckets[bucket];
+    ++histogram->count;
+    histogram->sum += value;
+    
+    if(histogram->count == 1 || value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+void KBHistogramMerge(KBHistogram *histogram, const KBHistogram *other)
+{
+    for(int i=0; i<HISTOGRAM_BUCKETS; i++) {
+        histogram->buckets[i] += other->buckets[i];
+    }
+    
+    if(other->count > 0 && (histogram->count == 0 || other->max > histogram->max)) {
+        histogram->max = other->max;
+    }
+    
+    histogram->count += other->count;
+    histogram->sum += other->sum;
+}
+
+double KBHistogramPercentile(const KBHistogram *histogram, double fraction)
+{
+    if(histogram->count == 0) {
+        return 0;
+    }
+    
+    // walk up the buckets until we've passed the requested share of samples
+    uint64_t target = (uint64_t)(fraction * histogram->count);
+    uint64_t seen = 0;
+    
+    for(int i=0; i<HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if(seen > target) {
+            // report the upper edge of the bucket (but never more than we've seen)
+            double limit = KBHistogramBucketLimit(histogram, i);
+            return (limit < histogram->max) ? limit : histogram->max;
+        }
+    }
+    
+    return histogram->max;
+}
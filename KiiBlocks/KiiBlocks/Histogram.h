@@ -0,0 +1,61 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#ifndef KiiBlocks_Histogram_h
+#define KiiBlocks_Histogram_h
+
+#include <stdint.h>
+
+// the number of buckets in every histogram - fixed so histograms can live
+// inside other structs without any allocation
+#define HISTOGRAM_BUCKETS   32
+
+// a fixed-size histogram, either with evenly spaced buckets or with buckets
+// that grow geometrically (better for latencies). values below the first
+// bucket land in it, values past the last bucket land in the last one
+typedef struct {
+    double min;
+    double width;               // linear buckets
+    double growth;              // exponential buckets, 0 when linear
+    uint64_t count;
+    double sum;
+    double max;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+} KBHistogram;
+
+// set up a histogram whose first bucket starts at 'min' and where each bucket is 'width' wide
+void KBHistogramInit(KBHistogram *histogram, double min, double width);
+
+// set up a histogram whose first bucket holds everything below 'first' and
+// where every following bucket is 'growth' times wider than the one before
+void KBHistogramInitExponential(KBHistogram *histogram, double first, double growth);
+
+// the upper edge of a bucket
+double KBHistogramBucketLimit(const KBHistogram *histogram, int bucket);
+
+// count a single value
+void KBHistogramAdd(KBHistogram *histogram, double value);
+
+// fold another histogram with the same bucket layout into this one
+void KBHistogramMerge(KBHistogram *histogram, const KBHistogram *other);
+
+// the (approximate) value below which the given fraction of samples fall
+double KBHistogramPercentile(const KBHistogram *histogram, double fraction);
+
+#endif
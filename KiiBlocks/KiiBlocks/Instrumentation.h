@@ -0,0 +1,74 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+// collects performance measurements from the game into fixed-size
+// histograms: how long each update: takes, how long the physics needs to
+// settle after a clear, how long a tap takes to resolve, how many nodes
+// are on screen and how long saving the game for later takes. all recording
+// happens on the main thread (the startup phases aside)
+@interface Instrumentation : NSObject
+
++ (Instrumentation*) sharedInstrumentation;
+
+// time spent in a single frame's update:
+- (void) recordUpdateMicros:(uint64_t)micros;
+
+// time from the touch event to the end of its resolution
+- (void) recordTapLatencyMicros:(uint64_t)micros;
+
+// time from a clear until every block came to rest
+- (void) recordSettleMicros:(uint64_t)micros;
+
+// number of nodes in the scene this frame
+- (void) recordNodeCount:(NSUInteger)count;
+
+// time taken to snapshot the game and write it to disk when the app goes away
+- (void) recordSaveGameMicros:(uint64_t)micros;
+
+// note that a step of the app's startup is done, timed from the moment the
+// process was started. only the first mark of each name counts, and unlike the
+// rest this may be called from any thread. 'interactive' is the one to watch -
+// the first frame the player can tap
+- (void) markStartupPhase:(NSString*)phase;
+
+// forget everything recorded so far
+- (void) reset;
+
+// a summary of every histogram (count, mean, percentiles and raw buckets),
+// the startup phases, and what each cache holds (see MemoryBudget)
+- (NSDictionary*) report;
+
+// the report as JSON, written to Documents/instrumentation.json - returns the path
+- (NSString*) exportJSON;
+
+// a short, human readable summary for the debug overlay
+- (NSString*) overlayText;
+
+@end
+
+// a label that sits over the game view and shows the instrumentation summary
+@interface InstrumentationOverlay : UILabel
+
+// start refreshing the text a couple of times a second
+- (void) startUpdating;
+
+@end
@@ -0,0 +1,241 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "Instrumentation.h"
+#import "Histogram.h"
+#import "MemoryBudget.h"
+
+#include <sys/sysctl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+@interface Instrumentation() {
+    KBHistogram _update;
+    KBHistogram _tapLatency;
+    KBHistogram _settle;
+    KBHistogram _nodeCount;
+    KBHistogram _saveGame;
+    
+    // milliseconds from process start to each startup phase
+    NSMutableDictionary *_startup;
+}
+
+@end
+
+@implementation Instrumentation
+
++ (Instrumentation*) sharedInstrumentation
+{
+    static Instrumentation *sharedInstrumentation = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstrumentation = [[Instrumentation alloc] init];
+    });
+    return sharedInstrumentation;
+}
+
+- (id) init
+{
+    self = [super init];
+    
+    if(self) {
+        _startup = [NSMutableDictionary dictionary];
+        [self reset];
+    }
+    
+    return self;
+}
+
+- (void) reset
+{
+    // latencies span a few microseconds to a few seconds, so their buckets grow by half each time
+    KBHistogramInitExponential(&_update, 50, 1.5);
+    KBHistogramInitExponential(&_tapLatency, 50, 1.5);
+    KBHistogramInitExponential(&_settle, 10000, 1.25);
+    KBHistogramInit(&_nodeCount, 0, 4);
+    KBHistogramInitExponential(&_saveGame, 100, 1.5);
+}
+
+- (void) recordUpdateMicros:(uint64_t)micros
+{
+    KBHistogramAdd(&_update, micros);
+}
+
+- (void) recordTapLatencyMicros:(uint64_t)micros
+{
+    KBHistogramAdd(&_tapLatency, micros);
+}
+
+- (void) recordSettleMicros:(uint64_t)micros
+{
+    KBHistogramAdd(&_settle, micros);
+}
+
+- (void) recordNodeCount:(NSUInteger)count
+{
+    KBHistogramAdd(&_nodeCount, count);
+}
+
+- (void) recordSaveGameMicros:(uint64_t)micros
+{
+    KBHistogramAdd(&_saveGame, micros);
+}
+
+// when the kernel started our process, in seconds since 1970 - this takes in
+// loading and linking, which happen before any of our code runs
+static double processStartTime(void)
+{
+    static double started = 0;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        struct kinfo_proc info;
+        size_t size = sizeof(info);
+        int name[] = {CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid()};
+        
+        if(sysctl(name, 4, &info, &size, NULL, 0) == 0) {
+            started = info.kp_proc.p_starttime.tv_sec + info.kp_proc.p_starttime.tv_usec / 1e6;
+        }
+    });
+    return started;
+}
+
+- (void) markStartupPhase:(NSString*)phase
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    double millis = (now.tv_sec + now.tv_usec / 1e6 - processStartTime()) * 1000;
+    
+    @synchronized(_startup) {
+        if([_startup objectForKey:phase] == nil) {
+            [_startup setObject:@(millis) forKey:phase];
+        }
+    }
+}
+
+- (NSDictionary*) summaryOf:(KBHistogram*)histogram
+{
+    NSMutableArray *buckets = [NSMutableArray arrayWithCapacity:HISTOGRAM_BUCKETS];
+    NSMutableArray *limits = [NSMutableArray arrayWithCapacity:HISTOGRAM_BUCKETS];
+    
+    for(int i=0; i<HISTOGRAM_BUCKETS; i++) {
+        [buckets addObject:@(histogram->buckets[i])];
+        [limits addObject:@(KBHistogramBucketLimit(histogram, i))];
+    }
+    
+    return @{@"count": @(histogram->count),
+             @"mean": @(histogram->count ? histogram->sum / histogram->count : 0),
+             @"max": @(histogram->max),
+             @"p50": @(KBHistogramPercentile(histogram, 0.50)),
+             @"p95": @(KBHistogramPercentile(histogram, 0.95)),
+             @"p99": @(KBHistogramPercentile(histogram, 0.99)),
+             @"bucketLimits": limits,
+             @"buckets": buckets};
+}
+
+- (NSDictionary*) startupPhases
+{
+    @synchronized(_startup) {
+        return [_startup copy];
+    }
+}
+
+- (NSDictionary*) report
+{
+    UIDevice *device = [UIDevice currentDevice];
+    
+    return @{@"device": @{@"model": device.model,
+                          @"system": [NSString stringWithFormat:@"%@ %@", device.systemName, device.systemVersion]},
+             @"updateMicros": [self summaryOf:&_update],
+             @"tapLatencyMicros": [self summaryOf:&_tapLatency],
+             @"settleMicros": [self summaryOf:&_settle],
+             @"nodeCount": [self summaryOf:&_nodeCount],
+             @"saveGameMicros": [self summaryOf:&_saveGame],
+             @"startupMillis": [self startupPhases],
+             @"memory": [[MemoryBudget sharedBudget] report]};
+}
+
+- (NSString*) exportJSON
+{
+    NSError *error = nil;
+    NSData *json = [NSJSONSerialization dataWithJSONObject:[self report]
+                                                   options:NSJSONWritingPrettyPrinted
+                                                     error:&error];
+    if(json == nil) {
+        NSLog(@"Unable to export instrumentation: %@", error);
+        return nil;
+    }
+    
+    NSString *documents = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, TRUE) lastObject];
+    NSString *path = [documents stringByAppendingPathComponent:@"instrumentation.json"];
+    [json writeToFile:path atomically:TRUE];
+    
+    return path;
+}
+
+- (NSString*) overlayText
+{
+    NSDictionary *startup = [self startupPhases];
+    NSDictionary *memory = [[MemoryBudget sharedBudget] report];
+    
+    return [NSString stringWithFormat:@"update  p50 %.0fus  p99 %.0fus  max %.0fus\n"
+                                      @"tap     p50 %.0fus  p99 %.0fus\n"
+                                      @"settle  p50 %.0fms  p99 %.0fms\n"
+                                      @"nodes   p50 %.0f  max %.0f\n"
+                                      @"start   interactive %.0fms  cloud %.0fms\n"
+                                      @"memory  caches %.0fKB  resident %.1fMB",
+            KBHistogramPercentile(&_update, 0.5), KBHistogramPercentile(&_update, 0.99), _update.max,
+            KBHistogramPercentile(&_tapLatency, 0.5), KBHistogramPercentile(&_tapLatency, 0.99),
+            KBHistogramPercentile(&_settle, 0.5) / 1000, KBHistogramPercentile(&_settle, 0.99) / 1000,
+            KBHistogramPercentile(&_nodeCount, 0.5), _nodeCount.max,
+            [[startup objectForKey:@"interactive"] doubleValue], [[startup objectForKey:@"sessionRestored"] doubleValue],
+            [[memory objectForKey:@"cacheBytes"] doubleValue] / 1024, [[memory objectForKey:@"residentBytes"] doubleValue] / (1024 * 1024)];
+}
+
+@end
+
+@implementation InstrumentationOverlay
+
+- (id) initWithFrame:(CGRect)frame
+{
+    self = [super initWithFrame:frame];
+    
+    if(self) {
+        self.backgroundColor = [UIColor colorWithWhite:0 alpha:0.5];
+        self.textColor = [UIColor greenColor];
+        self.font = [UIFont fontWithName:@"Courier" size:10.0f];
+        self.numberOfLines = 0;
+        self.userInteractionEnabled = FALSE;
+    }
+    
+    return self;
+}
+
+- (void) startUpdating
+{
+    if(self.superview == nil) {
+        return;
+    }
+    
+    self.text = [[Instrumentation sharedInstrumentation] overlayText];
+    
+    // keep refreshing for as long as we're on screen
+    [self performSelector:@selector(startUpdating) withObject:nil afterDelay:0.5];
+}
+
+@end
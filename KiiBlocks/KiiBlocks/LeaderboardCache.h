@@ -0,0 +1,81 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+// the number of entries the server keeps in the live leaderboard
+#define LEADERBOARD_SIZE    20
+
+// the time windows we keep leaderboards for, besides all time
+typedef enum {
+    LeaderboardWindowDay,
+    LeaderboardWindowWeek
+} LeaderboardWindow;
+
+// posted on the main thread whenever the cached entries change
+extern NSString * const LeaderboardCacheDidChangeNotification;
+
+// keeps a local copy of a leaderboard, seeded from the single object the
+// server code maintains for it. the global board is then kept current by
+// applying the delta messages pushed on the 'leaderboard' topic
+@interface LeaderboardCache : NSObject
+
+// an array of dictionaries with the keys 'score' and 'username', best first
+@property (nonatomic, readonly) NSArray *entries;
+
+// TRUE once the cache holds a full copy of the server leaderboard
+@property (nonatomic, readonly) BOOL seeded;
+
+// the global leaderboard
++ (LeaderboardCache*) sharedCache;
+
+// the leaderboard of a group (ie, friends) - maintained on the server as
+// each member submits a score, so loading it is one object read
++ (LeaderboardCache*) cacheForGroup:(KiiGroup*)group;
+
+// the best scores from the regional leaderboards around a location. the
+// server files each score under its geo cell, so this is an equality lookup
+// on a handful of small objects rather than a radius scan of every score
++ (LeaderboardCache*) cacheForRegionAroundLatitude:(double)latitude
+                                      andLongitude:(double)longitude;
+
+// the best scores of today or this week (in UTC, weeks start on Monday).
+// the server starts a new leaderboard object for every window, so once the
+// window rolls over this hands out a new, empty cache
++ (LeaderboardCache*) cacheForWindow:(LeaderboardWindow)window;
+
+// the name of the server's leaderboard object for the window containing a date
++ (NSString*) boardForWindow:(LeaderboardWindow)window containingDate:(NSDate*)date;
+
+- (id) initWithBucket:(KiiBucket*)bucket andBoard:(NSString*)board;
+
+// a cache merging several leaderboard objects from the same bucket
+- (id) initWithBucket:(KiiBucket*)bucket andBoards:(NSArray*)boards;
+
+// pull the full leaderboard from the server in a single object read
+- (void) seedWithBlock:(void (^)(NSError *error))block;
+
+// subscribe this device to the leaderboard topic so deltas are delivered
+- (void) subscribe;
+
+// apply a delta received through push - returns FALSE if it could not be
+// applied (ie, a message was missed) and the cache is re-seeding instead
+- (BOOL) applyDelta:(NSDictionary*)delta;
+
+@end
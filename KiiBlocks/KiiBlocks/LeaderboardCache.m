@@ -0,0 +1,333 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "LeaderboardCache.h"
+#import "GeoCell.h"
+#import "MemoryBudget.h"
+
+NSString * const LeaderboardCacheDidChangeNotification = @"LeaderboardCacheDidChangeNotification";
+
+@interface LeaderboardCache() {
+    NSMutableArray *_entries;
+    
+    // where the server keeps this leaderboard's object(s)
+    KiiBucket *_bucket;
+    NSArray *_boards;
+    
+    // the sequence number of the last delta applied to our entries
+    NSInteger _sequence;
+    
+    BOOL _seeding;
+}
+
+@end
+
+// the caches of boards other than the global one, kept so that switching
+// back and forth is instant - and dropped first when memory gets short
+static NSMutableDictionary *groupCaches = nil;
+static NSMutableDictionary *windowCaches = nil;
+static NSMutableDictionary *regionCaches = nil;
+
+// roughly what a cached entry (a dictionary, a number and a short name) takes up
+#define LEADERBOARD_ENTRY_BYTES     160
+
+@implementation LeaderboardCache
+
++ (void) initialize
+{
+    if(self != [LeaderboardCache class]) {
+        return;
+    }
+    
+    groupCaches = [NSMutableDictionary dictionary];
+    windowCaches = [NSMutableDictionary dictionary];
+    regionCaches = [NSMutableDictionary dictionary];
+    
+    // the other boards are read again in a single query when they're next shown
+    [[MemoryBudget sharedBudget] registerCache:@"leaderboards"
+                                          tier:MemoryTierCheap
+                                     footprint:^NSUInteger {
+        NSUInteger entries = 0;
+        for(NSDictionary *caches in @[groupCaches, windowCaches, regionCaches]) {
+            for(LeaderboardCache *cache in [caches allValues]) {
+                entries += 1 + cache->_entries.count;
+            }
+        }
+        return entries * LEADERBOARD_ENTRY_BYTES;
+    }
+                                         evict:^{
+        [groupCaches removeAllObjects];
+        [windowCaches removeAllObjects];
+        [regionCaches removeAllObjects];
+    }];
+}
+
++ (LeaderboardCache*) sharedCache
+{
+    static LeaderboardCache *sharedCache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedCache = [[LeaderboardCache alloc] initWithBucket:[Kii bucketWithName:@"leaderboard"]
+                                                      andBoard:@"global"];
+        
+        // the global board is kept current by push, so emptying it means
+        // going back to the server for the whole thing
+        [[MemoryBudget sharedBudget] registerCache:@"globalLeaderboard"
+                                              tier:MemoryTierCostly
+                                         footprint:^NSUInteger {
+            return sharedCache->_entries.count * LEADERBOARD_ENTRY_BYTES;
+        }
+                                             evict:^{
+            [sharedCache purge];
+        }];
+    });
+    return sharedCache;
+}
+
++ (LeaderboardCache*) cacheForGroup:(KiiGroup*)group
+{
+    // keep one cache per group so switching back and forth is instant
+    LeaderboardCache *cache = [groupCaches objectForKey:group.objectURI];
+    if(cache == nil) {
+        cache = [[LeaderboardCache alloc] initWithBucket:[group bucketWithName:@"leaderboard"]
+                                                andBoard:@"group"];
+        [groupCaches setObject:cache forKey:group.objectURI];
+    }
+    
+    return cache;
+}
+
++ (NSString*) boardForWindow:(LeaderboardWindow)window containingDate:(NSDate*)date
+{
+    static NSDateFormatter *formatter = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [[NSDateFormatter alloc] init];
+        formatter.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneWithName:@"UTC"];
+        formatter.dateFormat = @"yyyy-MM-dd";
+    });
+    
+    // the same sums as windowBoardsFor in the server code: whole days since
+    // the epoch, and the epoch was a Thursday
+    long long day = (long long)floor([date timeIntervalSince1970] / 86400);
+    
+    if(window == LeaderboardWindowWeek) {
+        long long monday = day - ((day + 3) % 7);
+        return [@"week:" stringByAppendingString:[formatter stringFromDate:[NSDate dateWithTimeIntervalSince1970:monday * 86400]]];
+    }
+    
+    return [@"day:" stringByAppendingString:[formatter stringFromDate:[NSDate dateWithTimeIntervalSince1970:day * 86400]]];
+}
+
++ (LeaderboardCache*) cacheForWindow:(LeaderboardWindow)window
+{
+    NSString *board = [LeaderboardCache boardForWindow:window containingDate:[NSDate date]];
+    
+    // only the current window is worth keeping around
+    LeaderboardCache *cache = [windowCaches objectForKey:@(window)];
+    if(cache == nil || ![cache->_boards isEqualToArray:@[board]]) {
+        cache = [[LeaderboardCache alloc] initWithBucket:[Kii bucketWithName:@"leaderboard"]
+                                                andBoard:board];
+        [windowCaches setObject:cache forKey:@(window)];
+    }
+    
+    return cache;
+}
+
++ (LeaderboardCache*) cacheForRegionAroundLatitude:(double)latitude
+                                      andLongitude:(double)longitude
+{
+    // everyone standing in the same cell shares a cache
+    NSString *center = [GeoCell cellForLatitude:latitude andLongitude:longitude];
+    
+    LeaderboardCache *cache = [regionCaches objectForKey:center];
+    if(cache == nil) {
+        
+        NSArray *cells = [GeoCell cellsAroundLatitude:latitude andLongitude:longitude];
+        
+        // regional boards live next to the global one, named after their cell
+        NSMutableArray *boards = [NSMutableArray arrayWithCapacity:cells.count];
+        for(NSString *cell in cells) {
+            [boards addObject:[@"geo:" stringByAppendingString:cell]];
+        }
+        
+        cache = [[LeaderboardCache alloc] initWithBucket:[Kii bucketWithName:@"leaderboard"]
+                                               andBoards:boards];
+        [regionCaches setObject:cache forKey:center];
+    }
+    
+    return cache;
+}
+
+- (id) initWithBucket:(KiiBucket*)bucket andBoard:(NSString*)board
+{
+    return [self initWithBucket:bucket andBoards:@[board]];
+}
+
+- (id) initWithBucket:(KiiBucket*)bucket andBoards:(NSArray*)boards
+{
+    self = [super init];
+    
+    if(self) {
+        _bucket = bucket;
+        _boards = boards;
+        _entries = [NSMutableArray arrayWithCapacity:LEADERBOARD_SIZE];
+        _sequence = -1;
+    }
+    
+    return self;
+}
+
+// forget the entries - the next refresh reads them from the server again
+- (void) purge
+{
+    [_entries removeAllObjects];
+    _sequence = -1;
+    _seeded = FALSE;
+    [self notifyChanged];
+}
+
+- (NSArray*) entries
+{
+    return [NSArray arrayWithArray:_entries];
+}
+
+// let anyone displaying the leaderboard know it has changed
+- (void) notifyChanged
+{
+    [[NSNotificationCenter defaultCenter] postNotificationName:LeaderboardCacheDidChangeNotification
+                                                        object:self];
+}
+
+- (void) seedWithBlock:(void (^)(NSError *error))block
+{
+    // don't stack up requests if we're already on our way
+    if(_seeding) {
+        if(block) block(nil);
+        return;
+    }
+    _seeding = TRUE;
+    
+    // the server keeps each whole top list in a single object
+    KiiClause *clause = (_boards.count == 1) ? [KiiClause equals:@"board" value:[_boards lastObject]]
+                                             : [KiiClause in:@"board" value:_boards];
+    KiiQuery *query = [KiiQuery queryWithClause:clause];
+    [query setLimit:(int)_boards.count];
+    
+    [_bucket executeQuery:query
+                withBlock:^(KiiQuery *query, KiiBucket *bucket, NSArray *results, KiiQuery *nextQuery, NSError *error) {
+        
+        _seeding = FALSE;
+        
+        if(error == nil) {
+            
+            // replace our entries with the server copy (short keys keep the object small)
+            [_entries removeAllObjects];
+            for(KiiObject *board in results) {
+                for(NSDictionary *entry in [board getObjectForKey:@"entries"]) {
+                    [_entries addObject:@{@"score": [entry objectForKey:@"s"],
+                                          @"username": [entry objectForKey:@"u"]}];
+                }
+            }
+            
+            // when merging several boards, keep the best of all of them
+            if(results.count > 1) {
+                [_entries sortUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"score" ascending:FALSE]]];
+                while(_entries.count > LEADERBOARD_SIZE) {
+                    [_entries removeLastObject];
+                }
+            }
+            
+            // an empty leaderboard has never received a delta
+            NSNumber *sequence = [[results lastObject] getObjectForKey:@"seq"];
+            _sequence = (sequence != nil) ? [sequence integerValue] : 0;
+            
+            _seeded = TRUE;
+            [self notifyChanged];
+        }
+        
+        if(block) block(error);
+    }];
+}
+
+- (void) subscribe
+{
+    KiiTopic *topic = [Kii topicWithName:@"leaderboard"];
+    
+    [KiiPushSubscription subscribe:topic withBlock:^(KiiPushSubscription *subscription, NSError *error) {
+        
+        // already being subscribed is reported as an error, but is harmless
+        if(error != nil) {
+            NSLog(@"Leaderboard subscription: %@", error);
+        }
+    }];
+}
+
+- (BOOL) applyDelta:(NSDictionary*)delta
+{
+    // ignore anything that isn't a leaderboard delta for this board (deltas
+    // are only published for single boards, never merged ones)
+    if(![[delta objectForKey:@"t"] isEqual:@"lb"] || _boards.count != 1 ||
+       ![[delta objectForKey:@"b"] isEqual:[_boards lastObject]]) {
+        return FALSE;
+    }
+    
+    // until we have a base copy there is nothing to apply the delta to
+    if(!_seeded) {
+        [self seedWithBlock:nil];
+        return FALSE;
+    }
+    
+    NSInteger sequence = [[delta objectForKey:@"q"] integerValue];
+    
+    // we've already seen this one (push may deliver more than once)
+    if(sequence <= _sequence) {
+        return TRUE;
+    }
+    
+    // we missed a message somewhere - fall back to a single re-seed
+    if(sequence != _sequence + 1) {
+        _seeded = FALSE;
+        [self seedWithBlock:nil];
+        return FALSE;
+    }
+    
+    NSUInteger rank = [[delta objectForKey:@"r"] unsignedIntegerValue];
+    if(rank > _entries.count || rank >= LEADERBOARD_SIZE) {
+        _seeded = FALSE;
+        [self seedWithBlock:nil];
+        return FALSE;
+    }
+    
+    // insert the new score at its rank and drop whoever fell off the end
+    [_entries insertObject:@{@"score": @([[delta objectForKey:@"s"] integerValue]),
+                             @"username": [delta objectForKey:@"u"]}
+                   atIndex:rank];
+    if(_entries.count > LEADERBOARD_SIZE) {
+        [_entries removeLastObject];
+    }
+    
+    _sequence = sequence;
+    [self notifyChanged];
+    
+    return TRUE;
+}
+
+@end
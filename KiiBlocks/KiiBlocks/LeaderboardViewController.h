@@ -8,9 +8,14 @@
 
 #import "KTTableViewController.h"
 
+@class LeaderboardCache;
+
 @interface LeaderboardViewController : KTTableViewController
 
 // allow the user score to be set from outside this class
 @property (nonatomic, assign) NSUInteger userScore;
 
+// the leaderboard being shown - defaults to the global leaderboard
+@property (nonatomic, strong) LeaderboardCache *cache;
+
 @end
@@ -7,9 +7,117 @@
 //
 
 #import "LeaderboardViewController.h"
+#import "ScoreDistribution.h"
+#import "LeaderboardCache.h"
+#import "LocationTracker.h"
+#import "CloudSession.h"
+
+@interface LeaderboardViewController() {
+    // the player's friends group, if they belong to one
+    KiiGroup *_friendsGroup;
+    
+    // which of the global/daily/weekly/friends/nearby boards is showing
+    NSInteger _selectedBoard;
+}
+
+@end
 
 @implementation LeaderboardViewController
 
+- (LeaderboardCache*) cache
+{
+    if(_cache == nil) {
+        _cache = [LeaderboardCache sharedCache];
+    }
+    return _cache;
+}
+
+- (void) viewDidLoad
+{
+    [super viewDidLoad];
+    
+    // look up the group the friends leaderboard belongs to (the session may
+    // still be being restored in the background)
+    [[CloudSession sharedSession] authenticateWithBlock:^(NSError *error) {
+        if(error != nil) {
+            return;
+        }
+        
+        [[KiiUser currentUser] memberOfGroupsWithBlock:^(KiiUser *user, NSArray *results, NSError *error) {
+            
+            // prefer a group called 'friends', otherwise use the first one we're in
+            for(KiiGroup *group in results) {
+                if(_friendsGroup == nil || [group.name isEqualToString:@"friends"]) {
+                    _friendsGroup = group;
+                }
+            }
+        }];
+    }];
+    
+    // find out where the user's score stands among everyone's
+    [[ScoreDistribution sharedDistribution] refreshWithBlock:^(NSError *error) {
+        [self.tableView reloadData];
+    }];
+    
+    // redraw whenever a pushed delta changes the cached leaderboard
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(leaderboardChanged:)
+                                                 name:LeaderboardCacheDidChangeNotification
+                                               object:nil];
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (void) leaderboardChanged:(NSNotification*)notification
+{
+    if(notification.object == self.cache) {
+        [self.tableView reloadData];
+    }
+}
+
+// switch between the global, daily, weekly, friends and nearby leaderboards
+- (void) boardChanged:(UISegmentedControl*)sender
+{
+    CLLocation *location = [LocationTracker sharedTracker].lastLocation;
+    
+    if(sender.selectedSegmentIndex == 1) {
+        self.cache = [LeaderboardCache cacheForWindow:LeaderboardWindowDay];
+    } else if(sender.selectedSegmentIndex == 2) {
+        self.cache = [LeaderboardCache cacheForWindow:LeaderboardWindowWeek];
+    } else if(sender.selectedSegmentIndex == 3 && _friendsGroup != nil) {
+        self.cache = [LeaderboardCache cacheForGroup:_friendsGroup];
+    } else if(sender.selectedSegmentIndex == 4 && location != nil) {
+        self.cache = [LeaderboardCache cacheForRegionAroundLatitude:location.coordinate.latitude
+                                                       andLongitude:location.coordinate.longitude];
+    } else {
+        self.cache = [LeaderboardCache sharedCache];
+        sender.selectedSegmentIndex = 0;
+    }
+    _selectedBoard = sender.selectedSegmentIndex;
+    
+    [self.tableView reloadData];
+    [self refreshQuery];
+}
+
+// the global leaderboard is served from the local cache, which is kept current
+// by push, so a refresh only goes to the server if the cache has never been
+// filled. the other boards aren't pushed - they re-read their object(s)
+- (void) refreshQuery
+{
+    LeaderboardCache *cache = self.cache;
+    
+    if(cache.seeded && cache == [LeaderboardCache sharedCache]) {
+        [self.tableView reloadData];
+    } else {
+        [cache seedWithBlock:^(NSError *error) {
+            [self.tableView reloadData];
+        }];
+    }
+}
+
 // called when the user clicks the 'done' button
 - (void) closeView:(id)sender
 {
@@ -17,19 +125,28 @@
     [self dismissViewControllerAnimated:TRUE completion:nil];
 }
 
-// create a cell for our score KiiObject
-- (UITableViewCell*) tableView:(UITableView *)tableView
-              cellForKiiObject:(KiiObject*)object
-                   atIndexPath:(NSIndexPath *)indexPath
+// one row for each cached leaderboard entry
+- (NSInteger) tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section
+{
+    return self.cache.entries.count;
+}
+
+// create a cell for a cached score entry
+- (UITableViewCell*) tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath
 {
     static NSString *identifier = @"MyCell";
     
-    UITableViewCell *cell = [[UITableViewCell alloc] initWithStyle:UITableViewCellStyleSubtitle
-                                                   reuseIdentifier:identifier];
+    UITableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:identifier];
+    if(cell == nil) {
+        cell = [[UITableViewCell alloc] initWithStyle:UITableViewCellStyleSubtitle
+                                      reuseIdentifier:identifier];
+    }
+    
+    NSDictionary *entry = [self.cache.entries objectAtIndex:indexPath.row];
     
     // set the textlabels of the subtitled table view cell
-    cell.textLabel.text = [[object getObjectForKey:@"score"] description];
-    cell.detailTextLabel.text = [object getObjectForKey:@"username"];
+    cell.textLabel.text = [[entry objectForKey:@"score"] description];
+    cell.detailTextLabel.text = [entry objectForKey:@"username"];
     
     return cell;
 }
@@ -48,6 +165,13 @@
     [close addTarget:self action:@selector(closeView:) forControlEvents:UIControlEventTouchUpInside];
     [header addSubview:close];
     
+    // add a switch between the global, daily, weekly, friends and nearby leaderboards
+    UISegmentedControl *boards = [[UISegmentedControl alloc] initWithItems:@[@"All", @"Today", @"Week", @"Friends", @"Nearby"]];
+    boards.frame = CGRectMake(10, 25, 230, 30);
+    boards.selectedSegmentIndex = _selectedBoard;
+    [boards addTarget:self action:@selector(boardChanged:) forControlEvents:UIControlEventValueChanged];
+    [header addSubview:boards];
+    
     // add the user's score label to the header
     UILabel *scoreLabel = [[UILabel alloc] initWithFrame:CGRectMake(0, 60, 320, 40)];
     scoreLabel.backgroundColor = [UIColor clearColor];
@@ -55,6 +179,13 @@
     scoreLabel.textColor = [UIColor whiteColor];
     scoreLabel.textAlignment = NSTextAlignmentCenter;
     scoreLabel.text = [NSString stringWithFormat:@"Your score: %d", _userScore];
+    
+    // and how it ranks, once we know
+    ScoreDistribution *distribution = [ScoreDistribution sharedDistribution];
+    if(distribution.loaded && distribution.count > 0) {
+        double top = MAX([distribution fractionAbove:_userScore] * 100, 0.1);
+        scoreLabel.text = [scoreLabel.text stringByAppendingFormat:@" (top %.1f%%)", top];
+    }
     [header addSubview:scoreLabel];
     
     return header;
@@ -0,0 +1,34 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+// keeps a rough idea of where the player is, for regional leaderboards.
+// only significant location changes are monitored to keep battery use low
+@interface LocationTracker : NSObject <CLLocationManagerDelegate>
+
+// the most recent location, or nil if we don't know (or aren't allowed to know)
+@property (nonatomic, readonly) CLLocation *lastLocation;
+
++ (LocationTracker*) sharedTracker;
+
+- (void) start;
+
+@end
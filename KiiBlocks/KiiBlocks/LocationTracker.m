@@ -0,0 +1,66 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "LocationTracker.h"
+
+@interface LocationTracker() {
+    CLLocationManager *_manager;
+}
+
+@end
+
+@implementation LocationTracker
+
++ (LocationTracker*) sharedTracker
+{
+    static LocationTracker *sharedTracker = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedTracker = [[LocationTracker alloc] init];
+    });
+    return sharedTracker;
+}
+
+- (void) start
+{
+    // nothing to do if the device can't (or the player won't) tell us
+    if(![CLLocationManager significantLocationChangeMonitoringAvailable] ||
+       [CLLocationManager authorizationStatus] == kCLAuthorizationStatusDenied) {
+        return;
+    }
+    
+    if(_manager == nil) {
+        _manager = [[CLLocationManager alloc] init];
+        _manager.delegate = self;
+    }
+    
+    [_manager startMonitoringSignificantLocationChanges];
+}
+
+- (void) locationManager:(CLLocationManager *)manager didUpdateLocations:(NSArray *)locations
+{
+    _lastLocation = [locations lastObject];
+}
+
+- (void) locationManager:(CLLocationManager *)manager didFailWithError:(NSError *)error
+{
+    NSLog(@"Location unavailable: %@", error);
+}
+
+@end
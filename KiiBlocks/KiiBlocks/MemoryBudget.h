@@ -0,0 +1,66 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+// warnings this close together mean the first round of shedding wasn't enough
+#define MEMORY_WARNING_ESCALATION_SECONDS   30
+
+// how readily a cache gives its memory back. the first memory warning sheds
+// the cheap tier; another one soon after sheds the costly tier as well
+typedef enum {
+    
+    // worked out again for free, or on demand (the hint table, leaderboards that aren't on screen)
+    MemoryTierCheap,
+    
+    // takes a server round trip or a visible hitch to get back
+    MemoryTierCostly
+} MemoryTier;
+
+// keeps track of how much memory each of the app's caches holds, and has
+// them give it back when the system runs low - before we're the app that
+// gets killed. caches register a way to measure themselves and a way to let
+// go of their contents; everything is on the main thread
+@interface MemoryBudget : NSObject
+
++ (MemoryBudget*) sharedBudget;
+
+// add a cache (replacing any registered under the same name). the blocks are
+// kept, so they shouldn't hold on to the cache strongly
+- (void) registerCache:(NSString*)name
+                  tier:(MemoryTier)tier
+             footprint:(NSUInteger (^)(void))footprint
+                 evict:(void (^)(void))evict;
+
+- (void) unregisterCache:(NSString*)name;
+
+// the bytes held by all registered caches right now
+- (NSUInteger) totalBytes;
+
+// shed whatever the tier allows, and everything cheaper. returns the bytes freed
+- (NSUInteger) shedTier:(MemoryTier)tier;
+
+// the system is running low - shed a tier, or two if it keeps happening
+- (void) didReceiveMemoryWarning;
+
+// a cache name to {tier, bytes, evictions} dictionary, plus the process'
+// resident size and the number of warnings so far (for debugging)
+- (NSDictionary*) report;
+
+@end
@@ -0,0 +1,165 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "MemoryBudget.h"
+
+#import <mach/mach.h>
+
+@interface MemoryBudget() {
+    
+    // name -> a dictionary with the cache's tier, blocks and eviction count
+    NSMutableDictionary *_caches;
+    
+    NSUInteger _warnings;
+    NSDate *_lastWarning;
+}
+
+@end
+
+@implementation MemoryBudget
+
++ (MemoryBudget*) sharedBudget
+{
+    static MemoryBudget *sharedBudget = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedBudget = [[MemoryBudget alloc] init];
+    });
+    return sharedBudget;
+}
+
+- (id) init
+{
+    self = [super init];
+    
+    if(self) {
+        _caches = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (void) registerCache:(NSString*)name
+                  tier:(MemoryTier)tier
+             footprint:(NSUInteger (^)(void))footprint
+                 evict:(void (^)(void))evict
+{
+    [_caches setObject:[@{@"tier": @(tier),
+                          @"footprint": [footprint copy],
+                          @"evict": [evict copy],
+                          @"evictions": @0} mutableCopy]
+                forKey:name];
+}
+
+- (void) unregisterCache:(NSString*)name
+{
+    [_caches removeObjectForKey:name];
+}
+
+- (NSUInteger) bytesOf:(NSDictionary*)cache
+{
+    NSUInteger (^footprint)(void) = [cache objectForKey:@"footprint"];
+    return footprint();
+}
+
+- (NSUInteger) totalBytes
+{
+    NSUInteger total = 0;
+    for(NSDictionary *cache in [_caches allValues]) {
+        total += [self bytesOf:cache];
+    }
+    return total;
+}
+
+- (NSUInteger) shedTier:(MemoryTier)tier
+{
+    NSUInteger freed = 0;
+    
+    // an eviction may register or unregister caches, so go over a copy
+    for(NSString *name in [_caches allKeys]) {
+        NSMutableDictionary *cache = [_caches objectForKey:name];
+        if(cache == nil || [[cache objectForKey:@"tier"] intValue] > tier) {
+            continue;
+        }
+        
+        NSUInteger before = [self bytesOf:cache];
+        if(before == 0) {
+            continue;
+        }
+        
+        void (^evict)(void) = [cache objectForKey:@"evict"];
+        evict();
+        
+        NSUInteger after = [self bytesOf:cache];
+        freed += (before > after) ? before - after : 0;
+        [cache setObject:@([[cache objectForKey:@"evictions"] integerValue] + 1) forKey:@"evictions"];
+    }
+    
+    return freed;
+}
+
+- (void) didReceiveMemoryWarning
+{
+    NSDate *now = [NSDate date];
+    
+    // a second warning close on the heels of the first - the cheap stuff wasn't enough
+    MemoryTier tier = MemoryTierCheap;
+    if(_lastWarning != nil && [now timeIntervalSinceDate:_lastWarning] < MEMORY_WARNING_ESCALATION_SECONDS) {
+        tier = MemoryTierCostly;
+    }
+    
+    ++_warnings;
+    _lastWarning = now;
+    
+    NSUInteger freed = [self shedTier:tier];
+    NSLog(@"Memory warning %lu: shed %lu bytes (tier %d), %lu left in caches",
+          (unsigned long)_warnings, (unsigned long)freed, tier, (unsigned long)[self totalBytes]);
+}
+
+// what the system counts against us
+static NSUInteger residentBytes(void)
+{
+    struct task_basic_info info;
+    mach_msg_type_number_t count = TASK_BASIC_INFO_COUNT;
+    
+    if(task_info(mach_task_self(), TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+}
+
+- (NSDictionary*) report
+{
+    NSMutableDictionary *caches = [NSMutableDictionary dictionaryWithCapacity:_caches.count];
+    
+    for(NSString *name in _caches) {
+        NSDictionary *cache = [_caches objectForKey:name];
+        [caches setObject:@{@"tier": [cache objectForKey:@"tier"],
+                            @"bytes": @([self bytesOf:cache]),
+                            @"evictions": [cache objectForKey:@"evictions"]}
+                   forKey:name];
+    }
+    
+    return @{@"caches": caches,
+             @"cacheBytes": @([self totalBytes]),
+             @"residentBytes": @(residentBytes()),
+             @"warnings": @(_warnings)};
+}
+
+@end
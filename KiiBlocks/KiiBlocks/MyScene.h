@@ -19,8 +19,31 @@
 
 #import <SpriteKit/SpriteKit.h>
 
+@class GameMode;
+
 @interface MyScene : SKScene <UIAlertViewDelegate>
 
 @property (nonatomic, weak) UIViewController *parentViewController;
 
+// the rules of the game being played
+@property (nonatomic, readonly) GameMode *mode;
+
+// a scene playing the given mode (initWithSize: plays the current mode)
+- (id) initWithSize:(CGSize)size mode:(GameMode*)mode;
+
+// upload a finished game's score that was waiting on the player to log in
+- (void) resumeScoreSubmission;
+
+// stop the clock and the blocks - the game carries on with the next tap
+- (void) pauseGame;
+
+// the game in progress (board, score and time left) in a few hundred bytes,
+// or nil if there's no game going on
+- (NSData*) snapshot;
+
+// carry on a game from a snapshot. the blocks are put straight where they
+// come to rest, and the game waits for a tap. returns FALSE if the snapshot
+// is damaged or was taken in another mode
+- (BOOL) restoreSnapshot:(NSData*)snapshot;
+
 @end
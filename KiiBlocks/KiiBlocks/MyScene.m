@@ -18,41 +18,132 @@
 //
 
 #import "MyScene.h"
+#import "AppDelegate.h"
 #import "BlockNode.h"
+#import "BoardLayout.h"
 #import "LeaderboardViewController.h"
+#import "GameAnalytics.h"
+#import "Instrumentation.h"
+#import "Clock.h"
+#import "Board.h"
+#import "BoardHint.h"
+#import "Scoring.h"
+#import "GameMode.h"
+#import "CloudSession.h"
+#import "ScoreQueue.h"
+#import "MemoryBudget.h"
+#import "TapQueue.h"
+#import "Simulation.h"
+#import "ReplayRecorder.h"
 
-// define some class-wide attributes for our scene
-#define COLUMNS         6
-#define ROWS            7
-#define MIN_BLOCK_BUST  2
-#define LEVEL_TIME      05.0f
+// how long the hint engine may think, in microseconds, and how many taps ahead it looks.
+// 3 is the deepest that fits the budget on the shipped modes, with or without
+// the transposition table (Tools/hintbench) - at 4 only 60-95% of the clusters
+// get rated in time either way
+#define HINT_BUDGET     5000
+#define HINT_LOOKAHEAD  3
 
 // our possible game states
 typedef enum {
     STOPPED,
     STARTING,
-    PLAYING
+    PLAYING,
+    PAUSED
 } GameState;
 
+// a game snapshot is this header, then the board's snapshot. the header is
+// the version, the score and the seconds played so far (in milliseconds)
+#define GAME_SNAPSHOT_VERSION       1
+#define GAME_SNAPSHOT_HEADER_BYTES  9
+
 @interface MyScene() {
     NSArray *_colors;
     
     SKLabelNode *_scoreLabel;
     SKLabelNode *_timerLabel;
+    SKLabelNode *_hintLabel;
     
     NSUInteger _score;
     
+    // a finished game's score on its way up (it may have to wait for a login)
+    NSUInteger _pendingScore;
+    NSData *_pendingReplay;
+    BOOL _scorePending;
+    
+    // cleared once the first frame has been drawn
+    BOOL _firstFrame;
+    
     GameState _gameState;
     CFTimeInterval _startedTime;
+    
+    // how long the game had been going when it was paused (0 for a new game),
+    // and the time of the last frame
+    CFTimeInterval _elapsed;
+    CFTimeInterval _lastUpdateTime;
+    
+    // when the last clear happened, while we wait for the blocks to settle (0 otherwise)
+    uint64_t _settleStartedMicros;
+    
+    // owns the logical board - which color is where, and which blocks form
+    // clusters - and plays the taps on it off the main thread
+    Simulation *_simulation;
+    
+    // the board on screen: its generation (a new one for every new board),
+    // how many taps have changed it and how many blocks have dropped into
+    // each column. taps are stamped with these so the simulation can tell
+    // what the player was looking at
+    uint16_t _generation;
+    uint32_t _appliedSequence;
+    uint32_t _shownDropped[BOARD_MAX_COLUMNS];
+    
+    // a diff already taken from the simulation but held back, as it comes
+    // after the board a snapshot was made of - it goes first next frame
+    KBBoardDiff *_heldDiff;
+    
+    // where every cell of the board goes on screen
+    BoardLayout *_layout;
+    
+    // the block nodes for each column, indexed by row (mirrors the simulation's board)
+    NSMutableArray *_columns;
+    
+    // the seed the board was set up with, and whether it's still as the seed
+    // made it (so a game starting on it can be played back)
+    uint64_t _seed;
+    BOOL _boardIsFresh;
+    
+    // taps thrown away (on a falling block, one cleared by an earlier tap, or
+    // while the simulation was too far behind), reported with the analytics
+    NSUInteger _rejectedTaps;
+    
+    // what every clear is worth in this mode, worked out when the board is
+    // set up, and how long a chain of clears the player has going
+    KBScoringTables *_scoringTables;
+    KBScoringChain _chain;
+    
+    // set when the time runs out - clears still on their way are shown, but
+    // no longer count
+    BOOL _gameOver;
+    
+    // writes down the game being played
+    ReplayRecorder *_recorder;
+    
+    // what the hint engine has already worked out, kept from one hint to the
+    // next. made on the first hint, and let go when memory is short
+    KBTranspositionTable *_hintTable;
+    
+    // hints being worked out in the background (they use the table)
+    NSUInteger _hintsRunning;
 }
 
-- (NSArray*) getAllBlocks;
-
 @end
 
 @implementation MyScene
 
 -(id)initWithSize:(CGSize)size {
+    return [self initWithSize:size mode:[GameMode currentMode]];
+}
+
+- (id) initWithSize:(CGSize)size mode:(GameMode*)mode {
     if (self = [super initWithSize:size]) {
         
         // The background color for our scene
@@ -61,17 +152,18 @@ typedef enum {
         // set the gravity of our world
         self.physicsWorld.gravity = CGVectorMake(0, -8.f);
 
-        // define a list of colors the blocks can potentially be
-        _colors = @[[UIColor greenColor], [UIColor blueColor], [UIColor yellowColor], [UIColor purpleColor]];
+        // define a list of colors the blocks can potentially be (the mode says how many are used)
+        _colors = @[[UIColor greenColor], [UIColor blueColor], [UIColor yellowColor], [UIColor purpleColor],
+                    [UIColor redColor], [UIColor orangeColor], [UIColor cyanColor], [UIColor whiteColor]];
 
         // create the floor for our scene
-        SKSpriteNode *floor = [SKSpriteNode spriteNodeWithColor:[UIColor blackColor] size:CGSizeMake(320, 40)];
+        SKSpriteNode *floor = [SKSpriteNode spriteNodeWithColor:[UIColor blackColor] size:CGSizeMake(size.width, BOARD_FOOTER_HEIGHT)];
         
         // set up its physics body and set attributes
         floor.physicsBody = [SKPhysicsBody bodyWithRectangleOfSize:floor.size];
         floor.physicsBody.restitution = 0.f;
         floor.physicsBody.dynamic = FALSE; // other objects react to it, but gravity doesn't affect it
-        floor.position = CGPointMake(160, 20);
+        floor.position = CGPointMake(size.width / 2, BOARD_FOOTER_HEIGHT / 2);
         
         // add the floor to our scene
         [self addChild:floor];
@@ -91,207 +183,424 @@ typedef enum {
         _timerLabel.fontColor = [UIColor whiteColor];
         _timerLabel.fontSize = 24.0f;
         _timerLabel.horizontalAlignmentMode = SKLabelHorizontalAlignmentModeRight;
-        _timerLabel.position = CGPointMake(310, 10);
+        _timerLabel.position = CGPointMake(size.width - 10, 10);
         [self.scene addChild:_timerLabel];
         
+        // and a label the user can tap for a hint
+        _hintLabel = [SKLabelNode labelNodeWithFontNamed:@"Arial"];
+        _hintLabel.name = @"hint";
+        _hintLabel.text = @"Hint";
+        _hintLabel.fontColor = [UIColor whiteColor];
+        _hintLabel.fontSize = 24.0f;
+        _hintLabel.horizontalAlignmentMode = SKLabelHorizontalAlignmentModeCenter;
+        _hintLabel.position = CGPointMake(size.width / 2, 10);
+        [self.scene addChild:_hintLabel];
         
-        // iterate through however many rows we want
-        for(int row=0; row<ROWS; row++) {
-            
-            // and in each row, iterate through the number of columns we want
-            for (int col=0; col<COLUMNS; col++) {
-                
-                // generate the width/height of the blocks based on the column count
-                CGFloat dimension = 320 / COLUMNS;
-                
-                // generate a random number within the range of our color list
-                NSUInteger colorIndex = arc4random() % _colors.count;
-                
-                // create the block with the specified size and position + the random color
-                BlockNode *node = [[BlockNode alloc] initWithRow:row
-                                                       andColumn:col
-                                                       withColor:[_colors objectAtIndex:colorIndex]
-                                                         andSize:CGSizeMake(dimension, dimension)];
-                
-                // add the block to our scene
-                [self.scene addChild:node];
-                
-            }
-
+        
+        _firstFrame = TRUE;
+        _recorder = [[ReplayRecorder alloc] init];
+        _simulation = [[Simulation alloc] init];
+        
+        // the hint table is only a head start for the hint engine - it can go whenever memory is short
+        __weak MyScene *scene = self;
+        [[MemoryBudget sharedBudget] registerCache:@"hintTable"
+                                              tier:MemoryTierCheap
+                                         footprint:^NSUInteger {
+            return [scene hintTableBytes];
         }
+                                             evict:^{
+            [scene releaseHintTable];
+        }];
         
+        // lay out and fill the board for this mode
+        [self setUpBoardWithMode:mode];
 
     }
     return self;
 }
 
-// determine if a node is directly on one side of the base node AND it is the same color
-- (BOOL) inRange:(BlockNode*)testNode of:(BlockNode*)baseNode
+// (re)build the board and its blocks for a mode
+- (void) setUpBoardWithMode:(GameMode*)mode
 {
-    // if the nodes are in the same row/column
-    BOOL isRow = (baseNode.row == testNode.row);
-    BOOL isCol = (baseNode.column == testNode.column);
+    _mode = mode;
     
-    // if the nodes are one row/column apart
-    BOOL oneOffCol = (baseNode.column+1 == testNode.column || baseNode.column-1 == testNode.column);
-    BOOL oneOffRow = (baseNode.row+1 == testNode.row || baseNode.row-1 == testNode.row);
+    // work out the size and position of the blocks for this screen
+    _layout = [[BoardLayout alloc] initWithSceneSize:self.size columns:mode.columns rows:mode.rows];
     
-    // if the nodes are the same color
-    BOOL sameColor = [baseNode.color isEqual:testNode.color];
+    // and what the clusters on it are worth
+    KBScoringRules rules;
+    [mode getScoringRules:&rules];
+    if(_scoringTables == NULL) {
+        _scoringTables = malloc(sizeof(KBScoringTables));
+    }
+    KBScoringTablesBuild(_scoringTables, &rules, mode.columns, mode.rows);
+    KBScoringChainReset(&_chain);
+    
+    // set up the logical board with a random seed
+    KBBoard *board = malloc(sizeof(KBBoard));
+    _seed = ((uint64_t)arc4random() << 32) | arc4random();
+    KBBoardInit(board, mode.columns, mode.rows, mode.colorCount, mode.minBust, _seed);
+    _boardIsFresh = TRUE;
     
-    // returns true when they are next to each other AND the same color
-    return ( (isRow && oneOffCol) || (isCol && oneOffRow) ) && sameColor;
+    [self showBoard:board settled:FALSE];
+    free(board);
 }
 
-// a recursive method used to find all similar blocks around a base block.
-// the recursion allows us to reach beyond the current block's immediate neighbors to
-// neighbors of neighbors, etc
-- (NSMutableArray*) nodesToRemove:(NSMutableArray*)removedNodes aroundNode:(BlockNode*)baseNode
+// hand a new board to the simulation and create the blocks for every one of
+// its cells, either dropping in from the top or already where they come to rest
+- (void) showBoard:(const KBBoard*)board settled:(BOOL)settled
 {
-    // make sure our base node is being removed
-    [removedNodes addObject:baseNode];
+    _generation = [_simulation resetWithBoard:board];
+    _appliedSequence = 0;
+    memcpy(_shownDropped, board->dropped, sizeof(_shownDropped));
+    _gameOver = FALSE;
+    
+    // clear away the blocks of the previous board, if any
+    for(NSArray *column in _columns) {
+        [column makeObjectsPerformSelector:@selector(removeFromParent)];
+    }
     
-    // go through all the blocks on the screen
-    for(BlockNode *childNode in [self getAllBlocks]) {
+    // create an empty list of blocks for each column
+    _columns = [NSMutableArray arrayWithCapacity:_mode.columns];
+    for(int col=0; col<_mode.columns; col++) {
+        [_columns addObject:[NSMutableArray arrayWithCapacity:_mode.rows]];
+    }
+    
+    // iterate through however many rows we want
+    for(int row=0; row<_mode.rows; row++) {
         
-        // if the node being tested is on one of the four sides off our base node
-        // and it is the same color, it is in range and valid to be removed
-        if([self inRange:childNode of:baseNode]) {
+        // and in each row, iterate through the number of columns we want
+        for (int col=0; col<_mode.columns; col++) {
             
-            // if we have not already checked if this block is being removed
-            if(![removedNodes containsObject:childNode]) {
-                
-                // test the blocks around this one for possible removal
-                removedNodes = [self nodesToRemove:removedNodes aroundNode:childNode];
-            }
+            // create a block in the color the board picked for this cell
+            CGPoint position = settled ? [_layout positionForColumn:col row:row] : [_layout spawnPositionForColumn:col row:row];
+            [self addBlockAtRow:row andColumn:col withColor:KBBoardColorAt(board, col, row) atPosition:position];
             
         }
+        
     }
-
-    return removedNodes;
 }
 
-// retrive objects for every block within the scene
-- (NSArray*) getAllBlocks
+- (void) dealloc
 {
-    NSMutableArray *blocks = [NSMutableArray array];
+    [[MemoryBudget sharedBudget] unregisterCache:@"hintTable"];
     
-    // iterate through all nodes
-    for(SKNode *childNode in self.scene.children) {
-        
-        // see if it's of type 'BlockNode'
-        if([childNode isKindOfClass:[BlockNode class]]) {
-            
-            // add it to our tracking array
-            [blocks addObject:childNode];
-        }
+    if(_hintTable != NULL) {
+        KBTranspositionTableDestroy(_hintTable);
+    }
+    free(_scoringTables);
+    free(_heldDiff);
+}
+
+- (NSUInteger) hintTableBytes
+{
+    return (_hintTable != NULL) ? (NSUInteger)KBTranspositionTableBytes(_hintTable) : 0;
+}
+
+- (void) releaseHintTable
+{
+    // a hint being worked out is still using it - it goes next time
+    if(_hintTable == NULL || _hintsRunning > 0) {
+        return;
     }
     
-    return [NSArray arrayWithArray:blocks];
+    KBTranspositionTableDestroy(_hintTable);
+    _hintTable = NULL;
+}
+
+// create a block node for a cell of the board and drop it in from the top
+- (BlockNode*) addBlockAtRow:(int)row andColumn:(int)col withColor:(int)colorIndex
+{
+    return [self addBlockAtRow:row andColumn:col withColor:colorIndex atPosition:[_layout spawnPositionForColumn:col row:row]];
+}
+
+// create a block node for a cell of the board and add it to the scene
+- (BlockNode*) addBlockAtRow:(int)row andColumn:(int)col withColor:(int)colorIndex atPosition:(CGPoint)position
+{
+    // the layout knows how big the blocks are and where they start out
+    CGFloat dimension = _layout.cellSize;
+    
+    // create the block with the specified size and position + the board's color
+    BlockNode *node = [[BlockNode alloc] initWithRow:row
+                                           andColumn:col
+                                           withColor:[_colors objectAtIndex:colorIndex]
+                                             andSize:CGSizeMake(dimension, dimension)
+                                          atPosition:position];
+    
+    // add the block to our scene, and keep track of it in its column
+    [self.scene addChild:node];
+    [[_columns objectAtIndex:col] addObject:node];
+    
+    return node;
 }
 
 // a touch event occurred on the scene
 -(void)touchesBegan:(NSSet *)touches withEvent:(UIEvent *)event {
     
-    // get a touch object
-    UITouch *touch = [touches anyObject];
+    // a paused game carries on with the next tap (which doesn't count as a move)
+    if(_gameState == PAUSED) {
+        [self resumeGame];
+        return;
+    }
     
-    // and the touch's location
-    CGPoint location = [touch locationInNode:self];
+    // every finger that came down counts - they're queued here, resolved in
+    // order by the simulation, and the blocks updated at the next frame
+    KBQueuedTap taps[TAP_QUEUE_SIZE];
+    int count = 0;
     
-    // see which node was touched based on the location of the touch
-    SKNode *node = [self nodeAtPoint:location];
+    for(UITouch *touch in touches) {
+        
+        // see which node was touched based on the location of the touch
+        SKNode *node = [self nodeAtPoint:[touch locationInNode:self]];
+        
+        // the user is asking for a hint
+        if([node.name isEqualToString:@"hint"]) {
+            [self showHint];
+            continue;
+        }
+        
+        // only blocks go on the queue
+        if(![node isKindOfClass:[BlockNode class]] || count == TAP_QUEUE_SIZE) {
+            continue;
+        }
+        BlockNode *block = (BlockNode*)node;
+        int row = (int)block.row;
+        int col = (int)block.column;
+        
+        // a block that hasn't landed yet isn't where the board has it - the
+        // player was aiming at something else
+        CGFloat target = [_layout positionForColumn:col row:row].y;
+        if(fabs(block.position.y - target) > _layout.cellSize / 2) {
+            ++_rejectedTaps;
+            continue;
+        }
+        
+        // once the time is up, taps no longer count
+        uint64_t micros = (uint64_t)(touch.timestamp * 1000000);
+        if(_gameOver || [self gameMillisAt:micros] > _mode.timeLimit * 1000) {
+            continue;
+        }
+        
+        KBQueuedTap tap;
+        memset(&tap, 0, sizeof(tap));
+        tap.micros = micros;
+        tap.columnStamp = _shownDropped[col];
+        tap.column = (uint8_t)col;
+        tap.row = (uint8_t)row;
+        tap.generation = _generation;
+        taps[count++] = tap;
+    }
+    
+    // fingers that came down together go in a fixed order, so they always resolve the same way
+    qsort(taps, count, sizeof(KBQueuedTap), KBQueuedTapCompare);
+    
+    // the simulation is too far behind to take them all - the taps it
+    // couldn't queue never happened
+    int queued = [_simulation queueTaps:taps count:count];
+    _rejectedTaps += count - queued;
+}
+
+// bring the blocks up to date with every tap the simulation has played since the last frame
+- (void) applyDiffs
+{
+    [self applyDiffsThrough:UINT32_MAX];
+}
+
+// the same, but stopping at the board the simulation had after the given
+// number of taps had changed it
+- (void) applyDiffsThrough:(uint32_t)sequence
+{
+    KBBoardDiff *diff;
     
-    // if it was a block being touched
-    if([node isKindOfClass:[BlockNode class]]) {
+    while((diff = (_heldDiff != NULL) ? _heldDiff : [_simulation nextDiff]) != NULL) {
+        _heldDiff = NULL;
+        
+        // a tap on a board that's been replaced since - it never happened
+        if(diff->generation != _generation) {
+            free(diff);
+            continue;
+        }
         
-        // cast it so we can access the attributes
-        BlockNode *clickedBlock = (BlockNode*)node;
+        // played after that board - keep it for later
+        if(diff->sequence > sequence) {
+            _heldDiff = diff;
+            break;
+        }
+        
+        // an earlier tap had cleared or moved the block under this one's finger
+        if(diff->outcome == KB_DIFF_REJECTED) {
+            ++_rejectedTaps;
+        } else {
+            [self applyDiff:diff];
+        }
+        
+        // measure from the moment the touch happened to the blocks being updated
+        [[Instrumentation sharedInstrumentation] recordTapLatencyMicros:KBClockMicros() - diff->micros];
+        free(diff);
+    }
+}
 
-        // print a notice to the log
-        NSLog(@"Node clicked: %@ => %d, %d", clickedBlock, clickedBlock.row, clickedBlock.column);
+// the time on the game clock when a tap happened, in milliseconds
+- (uint32_t) gameMillisAt:(uint64_t)micros
+{
+    double seconds = _elapsed;
+    if(_gameState == PLAYING) {
+        seconds = MAX(0, micros / 1000000.0 - _startedTime);
+    }
+    return (uint32_t)(seconds * 1000);
+}
+
+// show what a tap did, and score it
+- (void) applyDiff:(KBBoardDiff*)diff
+{
+    int cleared = (diff->outcome == KB_DIFF_CLEARED);
+    
+    // the clears of a game that's over are still shown, so the screen keeps up with the board - but that's all
+    if(cleared) {
+        [self applyOps:diff];
+    }
+    if(_gameOver) {
+        return;
+    }
+    
+    // if the user tapped on a valid block while the game is stopped,
+    // it's their indication that the game should now start
+    if(cleared && _gameState == STOPPED) {
+        _gameState = STARTING; // let it be so :)
+        _elapsed = 0;
+        _rejectedTaps = 0;
+        KBScoringChainReset(&_chain);
+        [[GameAnalytics sharedAnalytics] beginSession];
+        
+        // a fresh board can be played back from its seed
+        if(_boardIsFresh) {
+            [_recorder beginWithMode:_mode seed:_seed];
+        }
+    }
+    
+    // note the tap for our gameplay analytics - after the session has begun,
+    // so the tap that starts a game counts too (taps before the clock starts
+    // count as time 0)
+    float secondsSinceStart = (_gameState == PLAYING) ? (float)(diff->micros / 1000000.0 - _startedTime) : 0.f;
+    [[GameAnalytics sharedAnalytics] recordTapWithClusterSize:diff->clusterSize
+                                                        color:diff->color
+                                                      removed:cleared
+                                             secondsSinceStart:secondsSinceStart];
+    
+    if(!cleared) {
+        return;
+    }
+    _boardIsFresh = FALSE;
+    
+    // everything that went into the board goes into the replay too
+    uint32_t millis = [self gameMillisAt:diff->micros];
+    [_recorder recordTapAtColumn:diff->column row:diff->row millis:millis];
+    
+    // the mode's tables say what the whole clear is worth - its size, its
+    // color, how far into a chain it is and whether it took a whole color
+    _score = KBScoringAdd((uint32_t)_score, KBScoringTap(_scoringTables, &_chain, diff->removedCount, diff->color, diff->colorCleared, millis));
+    
+    // update our score label with the current score, once for the whole clear
+    _scoreLabel.text = [NSString stringWithFormat:@"Score: %lu", (unsigned long)_score];
+    
+    // start timing how long it takes everything to come to rest
+    _settleStartedMicros = KBClockMicros();
+}
 
-        // recursively retrieve all valid blocks around it
-        NSMutableArray *objectsToRemove = [self nodesToRemove:[NSMutableArray array] aroundNode:clickedBlock];
+// move the blocks around as the diff says (see BoardDiff.h for the order things come in)
+- (void) applyOps:(const KBBoardDiff*)diff
+{
+    for(uint32_t i=0; i<diff->opCount; i++) {
+        const KBDiffOp *op = &diff->ops[i];
+        NSMutableArray *column = [_columns objectAtIndex:op->column];
         
-        // ensure that there are enough connected blocks selected
-        if(objectsToRemove.count >= MIN_BLOCK_BUST) {
+        switch(op->kind) {
             
-            // if the user tapped on a valid block while the game is stopped,
-            // it's their indication that the game should now start
-            if(_gameState == STOPPED) {
-                _gameState = STARTING; // let it be so :)
-            }
+            // remove the busted blocks from the scene (top down, so the indexes stay valid)
+            case KB_DIFF_REMOVE:
+                [[column objectAtIndex:op->row] removeFromParent];
+                [column removeObjectAtIndex:op->row];
+                break;
+            
+            // the blocks that are left fall down - once the removes are
+            // done, a block's index in its column is already its new row
+            case KB_DIFF_MOVE:
+                ((BlockNode*)[column objectAtIndex:op->value]).row = op->value;
+                break;
+            
+            // make sure our grid stays full by dropping in new blocks on top
+            case KB_DIFF_SPAWN:
+                [self addBlockAtRow:op->row andColumn:op->column withColor:op->value];
+                ++_shownDropped[op->column];
+                break;
             
-            // iterate through everything we need to delete
-            for(BlockNode *deleteNode in objectsToRemove) {
-                
-                // remove it from the scene
-                [deleteNode removeFromParent];
-                
-                // and decrement the 'row' variable for all blocks that sit above the one being removed
-                for(BlockNode *testNode in [self getAllBlocks]) {
-                    if(deleteNode.column == testNode.column && (deleteNode.row < testNode.row)) {
-                        --testNode.row;
+            // the board ran out of moves and was reshuffled - repaint the block to match
+            case KB_DIFF_RECOLOR:
+                ((BlockNode*)[column objectAtIndex:op->row]).color = [_colors objectAtIndex:op->value];
+                break;
+        }
+    }
+    
+    _appliedSequence = diff->sequence;
+}
+
+// work out the best move on a background queue and flash its blocks
+- (void) showHint
+{
+    // the hint engine works on its own copy of the board, so the game can go on meanwhile
+    KBBoard *board = malloc(sizeof(KBBoard));
+    uint32_t sequence = [_simulation copyBoard:board];
+    uint16_t generation = _generation;
+    
+    // a 256KB table for the hint engine. at our lookahead it spares 10-25% of
+    // the positions a hint looks at, but hintbench shows no gain in how long
+    // hints take - it's kept because it doesn't cost time either, and is
+    // given back under memory pressure
+    if(_hintTable == NULL) {
+        _hintTable = KBTranspositionTableCreate(14);
+    }
+    KBTranspositionTable *table = _hintTable;
+    ++_hintsRunning;
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        KBHint hint;
+        BOOL found = KBBoardHint(board, HINT_BUDGET, HINT_LOOKAHEAD, table, &hint);
+        
+        // every block in the suggested cluster shares its label
+        NSMutableArray *cells = [NSMutableArray array];
+        if(found) {
+            int label = board->label[BOARD_INDEX(hint.column, hint.row)];
+            for(int c=0; c<board->columns; c++) {
+                for(int r=0; r<board->rows; r++) {
+                    if(board->label[BOARD_INDEX(c, r)] == label) {
+                        [cells addObject:@[@(c), @(r)]];
                     }
                 }
-                
-                // whenever a block is destroyed, increment the score
-                ++_score;
-                
-                // update our score label with the current score
-                _scoreLabel.text = [NSString stringWithFormat:@"Score: %d", _score];
             }
+        }
+        free(board);
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
             
+            --_hintsRunning;
             
-            // make sure our grid stays full even when blocks are removed by...
+            // the hint only applies to the board it was worked out on - if
+            // that's not what's on screen (any more), it's no use
+            if(generation != _generation || sequence != _appliedSequence) {
+                return;
+            }
             
-            // initialize an array of 'maximum indexes for each column'
-            NSUInteger totalRows[COLUMNS];
-            for(int i=0; i<COLUMNS; i++) totalRows[i] = 0;
+            SKAction *fade = [SKAction sequence:@[[SKAction fadeAlphaTo:0.3f duration:0.15],
+                                                  [SKAction fadeAlphaTo:1.f duration:0.15]]];
             
-            // walk through our blocks
-            for(BlockNode *node in [self getAllBlocks]) {
-                
-                // get the index of the highest row in each column
-                if(node.row > totalRows[node.column]) {
-                    totalRows[node.column] = node.row;
-                }
-            }
-
-            // walk through each column
-            for(int col=0; col<COLUMNS; col++) {
-                
-                // while there are not enough rows to fill the grid, create new blocks
-                while (totalRows[col] < ROWS-1) {
-
-                    // generate the width/height of the blocks based on the column count
-                    CGFloat dimension = 320 / COLUMNS;
-                    
-                    // generate a random number within the range of our color list
-                    NSUInteger colorIndex = arc4random() % _colors.count;
-                    
-                    // create the block with the specified size and position + the random color
-                    BlockNode *node = [[BlockNode alloc] initWithRow:totalRows[col]+1 // the new row will be the top row in this column
-                                                           andColumn:col
-                                                           withColor:[_colors objectAtIndex:colorIndex]
-                                                             andSize:CGSizeMake(dimension, dimension)];
-                    
-                    // add the block to our scene
-                    [self.scene addChild:node];
-                    
-                    // increment the number of rows in this particular column
-                    ++totalRows[col];
-                
-                }
-                
+            for(NSArray *cell in cells) {
+                NSArray *column = [_columns objectAtIndex:[[cell objectAtIndex:0] intValue]];
+                BlockNode *block = [column objectAtIndex:[[cell objectAtIndex:1] intValue]];
+                [block runAction:[SKAction repeatAction:fade count:2]];
             }
-            
-        }
-        
-        
-    }
-    
+        });
+    });
 }
 
 // call this method to show the modal leaderboard view
@@ -301,66 +610,68 @@ typedef enum {
     LeaderboardViewController *lvc = [[LeaderboardViewController alloc] init];
     
     // set the user's last score for viewing
-    lvc.userScore = _score;
-    
-    // tell the table which bucket to retrieve the data from
-    lvc.bucket = [Kii bucketWithName:@"scores"];
-    
-    // create a query to retrieve the scores
-    KiiQuery *query = [KiiQuery queryWithClause:nil];
-    [query sortByDesc:@"score"];
-    [query setLimit:20];
-    
-    // set the query to the leaderboard view controller
-    lvc.query = query;
+    lvc.userScore = _pendingScore;
     
     // show the leaderboard
     [self.parentViewController presentViewController:lvc animated:TRUE completion:nil];
     
-    // pull the data from the server
+    // show the cached scores - this only hits the server if the cache is cold,
+    // after that the leaderboard is kept current by pushed deltas
     [lvc refreshQuery];
-    
-    // reset the score tracker for the next game
-    _score = 0;
 }
 
 // when the user has clicked 'ok' after viewing their score...
 - (void) alertView:(UIAlertView *)alertView clickedButtonAtIndex:(NSInteger)buttonIndex
 {
+    // set the score and its replay aside and reset the score tracker for the next game
+    _pendingScore = _score;
+    _pendingReplay = [_recorder finishWithScore:_score];
+    _scorePending = TRUE;
+    _score = 0;
+    
+    // every game starts on a fresh board, so it can be played back from its
+    // seed - in the mode from the cloud, if a different one has come down
+    [self setUpBoardWithMode:[GameMode currentMode]];
+    
+    [self submitScore];
+}
 
-    // let them know we're uploading their score
-    [KTLoader showLoader:@"Uploading Score..."];
+// send the pending score up - straight away if we have a session, otherwise once the player has logged in
+- (void) submitScore
+{
+    CloudSession *session = [CloudSession sharedSession];
     
-    // create their score as a KiiObject
-    KiiObject *scoreObject = [[Kii bucketWithName:@"scores"] createObject];
+    // this is the first time we need to know who the player is - if we
+    // don't, ask them to log in. the score goes up when the login view
+    // is dismissed (see resumeScoreSubmission)
+    if(!session.hasSession) {
+        KTLoginViewController *lvc = [[KTLoginViewController alloc] init];
+        [self.parentViewController presentViewController:lvc animated:TRUE completion:nil];
+        return;
+    }
     
-    // fill the object with the score and username
-    [scoreObject setObject:[NSNumber numberWithInt:_score] forKey:@"score"];
-    [scoreObject setObject:[KiiUser currentUser].username forKey:@"username"];
+    // the score is queued and sent in the background (and again later if
+    // that fails) - the player goes straight on to the leaderboard
+    _scorePending = FALSE;
+    [[ScoreQueue sharedQueue] addScore:_pendingScore withReplay:_pendingReplay];
+    _pendingReplay = nil;
+    [self showLeaderboard];
+}
+
+- (void) resumeScoreSubmission
+{
+    CloudSession *session = [CloudSession sharedSession];
     
-    // save the score to the cloud bucket "scores"
-    [scoreObject saveWithBlock:^(KiiObject *object, NSError *error) {
-        
-        // see if there was an error (if not, was successful!)
-        if(error == nil) {
-            
-            // hide the loader
-            [KTLoader hideLoader];
-            
-            // show the leaderboard
-            [self showLeaderboard];
-        }
+    if(_scorePending && session.ready && [KiiUser loggedIn]) {
         
-        // something bad happened
-        else {
-            
-            // tell the user
-            [KTLoader showLoader:@"Error saving!"
-                        animated:TRUE
-                   withIndicator:KTLoaderIndicatorError
-                 andHideInterval:KTLoaderDurationAuto];
-        }
-    }];
+        // the player has just logged in - keep their session for next time,
+        // send the analytics of the games they played before they did, and
+        // start getting leaderboard updates without waiting for a relaunch
+        [session saveSession];
+        [self submitScore];
+        [[GameAnalytics sharedAnalytics] flush];
+        [(AppDelegate*)[UIApplication sharedApplication].delegate subscribeToLeaderboard];
+    }
 }
 
 // called when the game is over
@@ -368,9 +679,13 @@ typedef enum {
 {
     // indicate our game state as stopped
     _gameState = STOPPED;
+    _gameOver = TRUE;
+    
+    // wrap up this game's analytics into a single summary
+    [[GameAnalytics sharedAnalytics] endSessionWithScore:_score rejectedTaps:_rejectedTaps];
     
     // create a message to let the user know their score
-    NSString *message = [NSString stringWithFormat:@"You scored %d this time", _score];
+    NSString *message = [NSString stringWithFormat:@"You scored %lu this time", (unsigned long)_score];
     
     // show the message to the user
     UIAlertView *av = [[UIAlertView alloc] initWithTitle:@"Game over!"
@@ -381,30 +696,139 @@ typedef enum {
     [av show];
 }
 
+- (void) pauseGame
+{
+    if(_gameState == PLAYING) {
+        _elapsed = _lastUpdateTime - _startedTime;
+    } else if(_gameState != STARTING) {
+        return;
+    }
+    
+    _gameState = PAUSED;
+    _timerLabel.text = @"Paused";
+    
+    // stops the physics too, so falling blocks hang where they are
+    self.paused = TRUE;
+}
+
+- (void) resumeGame
+{
+    // the clock picks up from where it was on the next frame
+    _gameState = STARTING;
+    self.paused = FALSE;
+}
+
+- (NSData*) snapshot
+{
+    if(_gameState == STOPPED) {
+        return nil;
+    }
+    
+    // show (and score) every tap the simulation had played when its board
+    // was copied - and none after - so the score matches the board, the
+    // same way a hint only goes with the board it was worked out on. taps
+    // still waiting for room in the diff queue haven't been played - the
+    // snapshot leaves them out, like any taps that come after it
+    KBBoard *board = malloc(sizeof(KBBoard));
+    uint32_t sequence = [_simulation copyBoard:board];
+    [self applyDiffsThrough:sequence];
+    
+    CFTimeInterval elapsed = (_gameState == PLAYING) ? _lastUpdateTime - _startedTime : _elapsed;
+    uint32_t score = OSSwapHostToLittleInt32((uint32_t)_score);
+    uint32_t millis = OSSwapHostToLittleInt32((uint32_t)(elapsed * 1000));
+    uint8_t buffer[GAME_SNAPSHOT_HEADER_BYTES + BOARD_SNAPSHOT_MAX_BYTES];
+    
+    buffer[0] = GAME_SNAPSHOT_VERSION;
+    memcpy(buffer + 1, &score, 4);
+    memcpy(buffer + 5, &millis, 4);
+    size_t size = KBBoardSnapshot(board, buffer + GAME_SNAPSHOT_HEADER_BYTES, BOARD_SNAPSHOT_MAX_BYTES);
+    free(board);
+    
+    return [NSData dataWithBytes:buffer length:GAME_SNAPSHOT_HEADER_BYTES + size];
+}
+
+- (BOOL) restoreSnapshot:(NSData*)snapshot
+{
+    const uint8_t *bytes = snapshot.bytes;
+    if(snapshot.length <= GAME_SNAPSHOT_HEADER_BYTES || bytes[0] != GAME_SNAPSHOT_VERSION) {
+        return FALSE;
+    }
+    
+    KBBoard *board = malloc(sizeof(KBBoard));
+    size_t size = KBBoardRestore(board, bytes + GAME_SNAPSHOT_HEADER_BYTES, snapshot.length - GAME_SNAPSHOT_HEADER_BYTES);
+    
+    // the mode may have changed since - a board from another one can't carry on here
+    if(size == 0 || board->columns != _mode.columns || board->rows != _mode.rows ||
+       board->colorCount != _mode.colorCount || board->minBust != _mode.minBust) {
+        free(board);
+        return FALSE;
+    }
+    
+    // the board no longer comes from a seed, so this game can't be recorded
+    _boardIsFresh = FALSE;
+    [_recorder discard];
+    
+    uint32_t score, millis;
+    memcpy(&score, bytes + 1, 4);
+    memcpy(&millis, bytes + 5, 4);
+    
+    // put the blocks straight where they'd come to rest - no waiting on the physics
+    [self showBoard:board settled:TRUE];
+    free(board);
+    
+    // the chain the game had going isn't in the snapshot - start a new one
+    KBScoringChainReset(&_chain);
+    
+    _score = OSSwapLittleToHostInt32(score);
+    _scoreLabel.text = [NSString stringWithFormat:@"Score: %lu", (unsigned long)_score];
+    
+    _elapsed = OSSwapLittleToHostInt32(millis) / 1000.0;
+    _gameState = PAUSED;
+    _timerLabel.text = @"Paused";
+    
+    // the game goes on from here, so its analytics start over - it's
+    // reported as a game of its own when it ends
+    _rejectedTaps = 0;
+    [[GameAnalytics sharedAnalytics] beginSession];
+    
+    return TRUE;
+}
+
 /* Called before each frame is rendered */
 -(void)update:(CFTimeInterval)currentTime {
     
+    uint64_t updateStarted = KBClockMicros();
+    
+    // the board is on screen and taking taps from here on
+    if(_firstFrame) {
+        [[Instrumentation sharedInstrumentation] markStartupPhase:@"interactive"];
+        _firstFrame = FALSE;
+    }
+    
     // if our player has indicated the start of the game
     if(_gameState == STARTING) {
         
-        // note the time for us to update the timer
-        _startedTime = currentTime;
+        // note the time for us to update the timer (a resumed game has already been going a while)
+        _startedTime = currentTime - _elapsed;
         
         // update our current game state
         _gameState = PLAYING;
     }
     
+    // show what the taps since the last frame did
+    [self applyDiffs];
+    
     // if we are playing the game, make any updates that are needed
     if(_gameState == PLAYING) {
         
         // figure out how much time is left (rounded for clarity)
-        int timeLeftRounded = ceil(LEVEL_TIME + (_startedTime - currentTime));
+        int timeLeftRounded = ceil(_mode.timeLimit + (_startedTime - currentTime));
         
         // update our timer label for the user
         _timerLabel.text = [NSString stringWithFormat:@"Time: %d", timeLeftRounded];
         
         // if we have no time left, the game is over
-        if(timeLeftRounded == 0) {
+        if(timeLeftRounded <= 0) {
             
             // call our game over method
             [self gameEnded];
@@ -419,6 +843,29 @@ typedef enum {
         node.position = CGPointMake(roundf(node.position.x), roundf(node.position.y));
     }
     
+    _lastUpdateTime = currentTime;
+    
+    Instrumentation *instrumentation = [Instrumentation sharedInstrumentation];
+    [instrumentation recordNodeCount:self.children.count];
+    [instrumentation recordUpdateMicros:KBClockMicros() - updateStarted];
+}
+
+/* Called once the physics has been simulated for this frame */
+-(void)didSimulatePhysics {
+    
+    // if we're waiting on blocks to fall into place after a clear
+    if(_settleStartedMicros != 0) {
+        
+        // see whether any of them are still moving
+        for(SKNode *node in self.children) {
+            if(node.physicsBody.dynamic && !node.physicsBody.resting) {
+                return;
+            }
+        }
+        
+        [[Instrumentation sharedInstrumentation] recordSettleMicros:KBClockMicros() - _settleStartedMicros];
+        _settleStartedMicros = 0;
+    }
 }
 
 
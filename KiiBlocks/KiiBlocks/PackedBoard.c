@@ -0,0 +1,455 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#include "PackedBoard.h"
+
+#include <string.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// the rules below are written once, taking the board size as arguments, and
+// stamped out for a few fixed sizes. forcing them inline into each copy is
+// what lets the compiler specialize them
+#define KB_KERNEL   static inline __attribute__((always_inline))
+
+// drop the bits of x marked in 'removed', shifting everything above them down
+static inline uint64_t KBPackedCompact(uint64_t x, uint64_t removed)
+{
+#if defined(__BMI2__)
+    return _pext_u64(x, ~removed);
+#else
+    // take the removed bits out one at a time from the top, so the positions
+    // of the ones below don't move
+    while(removed) {
+        int bit = 63 - __builtin_clzll(removed);
+        uint64_t below = (1ULL << bit) - 1;
+        
+        x = (x & below) | ((x >> 1) & ~below);
+        removed &= below;
+    }
+    return x;
+#endif
+}
+
+// put a color into a cell whose bits are all clear
+static inline void KBPackedSet(KBPackedBoard *board, int column, int row, int color)
+{
+    for(int p=0; p<PACKED_BOARD_PLANES; p++) {
+        board->planes[column][p] |= (uint64_t)((color >> p) & 1) << row;
+    }
+}
+
+// flood the cluster around a cell into 'region' (one mask per column) and
+// return its size. 'masks' holds the cells of the cluster's color per column
+KB_KERNEL int KBPackedFlood(int columns, const uint64_t *masks, int column, int row, uint64_t *region, int *first, int *last)
+{
+    int lo = column;
+    int hi = column;
+    
+    region[column] = 1ULL << row;
+    
+    // grow the region until it stops changing: spread in from the neighbouring
+    // columns, then up and down the column, sweeping left to right and back
+    int changed = 1;
+    while(changed) {
+        changed = 0;
+        
+        for(int pass=0; pass<2; pass++) {
+            int from = (pass == 0) ? ((lo > 0) ? lo-1 : 0) : ((hi < columns-1) ? hi+1 : hi);
+            int to = (pass == 0) ? ((hi < columns-1) ? hi+1 : hi) : ((lo > 0) ? lo-1 : 0);
+            int step = (pass == 0) ? 1 : -1;
+            
+            for(int c=from; c!=to+step; c+=step) {
+                uint64_t bits = (c >= lo && c <= hi) ? region[c] : 0;
+                uint64_t grown = bits;
+                
+                if(c > 0 && c-1 >= lo && c-1 <= hi) grown |= region[c-1];
+                if(c+1 < columns && c+1 >= lo && c+1 <= hi) grown |= region[c+1];
+                grown &= masks[c];
+                
+                if(grown == 0) {
+                    continue;
+                }
+                
+                // fill up and down the column within its cells of the color
+                uint64_t previous;
+                do {
+                    previous = grown;
+                    grown |= ((grown << 1) | (grown >> 1)) & masks[c];
+                } while(grown != previous);
+                
+                if(grown != bits) {
+                    if(c < lo) { lo = c; }
+                    if(c > hi) { hi = c; }
+                    region[c] = grown;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    
+    int size = 0;
+    for(int c=lo; c<=hi; c++) {
+        size += __builtin_popcountll(region[c]);
+    }
+    
+    *first = lo;
+    *last = hi;
+    return size;
+}
+
+// the same flood for boards of up to 64 cells, which fit in a single word:
+// the columns are laid end to end, so spreading sideways is a shift by the
+// column height and the whole cluster grows a step at a time in a few bit
+// operations. with the size known up front the shifts and masks are constants
+KB_KERNEL int KBPackedFloodWord(int columns, int rows, const uint64_t *masks, int column, int row, uint64_t *region, int *first, int *last)
+{
+    uint64_t rowMask = (1ULL << rows) - 1;
+    uint64_t mask = 0;
+    uint64_t bottom = 0;
+    
+    for(int c=0; c<columns; c++) {
+        mask |= masks[c] << (c * rows);
+        bottom |= 1ULL << (c * rows);
+    }
+    
+    // the top and bottom cells of a column mustn't spread into the next one up or down
+    uint64_t top = bottom << (rows - 1);
+    
+    uint64_t grown = 1ULL << (column * rows + row);
+    uint64_t previous;
+    do {
+        previous = grown;
+        grown |= (((grown & ~top) << 1) | ((grown & ~bottom) >> 1) | (grown << rows) | (grown >> rows)) & mask;
+    } while(grown != previous);
+    
+    *first = __builtin_ctzll(grown) / rows;
+    *last = (63 - __builtin_clzll(grown)) / rows;
+    
+    for(int c=*first; c<=*last; c++) {
+        region[c] = (grown >> (c * rows)) & rowMask;
+    }
+    
+    return __builtin_popcountll(grown);
+}
+
+// the cells of one color in every column
+KB_KERNEL void KBPackedColorMasks(const KBPackedBoard *board, int columns, int color, uint64_t *masks)
+{
+    for(int c=0; c<columns; c++) {
+        masks[c] = KBPackedBoardColorMask(board, c, color);
+    }
+}
+
+// small boards flood in a single word (a single 64 row column would need
+// shifts of 64, so it takes the long way)
+KB_KERNEL int KBPackedFloodCluster(int columns, int rows, const uint64_t *masks, int column, int row, uint64_t *region, int *first, int *last)
+{
+    if(columns * rows <= 64 && rows < 64) {
+        return KBPackedFloodWord(columns, rows, masks, column, row, region, first, last);
+    }
+    return KBPackedFlood(columns, masks, column, row, region, first, last);
+}
+
+// the rules with the board size passed in. each is only ever called with
+// constants (from the size-specific kernels below) or from the generic
+// kernel, so the compiler can unroll and fold them for the common sizes
+
+KB_KERNEL int KBPackedClusterSizeKernel(const KBPackedBoard *board, int columns, int rows, int column, int row)
+{
+    uint64_t masks[BOARD_MAX_COLUMNS];
+    uint64_t region[BOARD_MAX_COLUMNS];
+    int first, last;
+    
+    KBPackedColorMasks(board, columns, KBPackedBoardColorAt(board, column, row), masks);
+    return KBPackedFloodCluster(columns, rows, masks, column, row, region, &first, &last);
+}
+
+KB_KERNEL int KBPackedHasMoveKernel(const KBPackedBoard *board, int columns, int rows)
+{
+    uint64_t rowMask = (rows >= 64) ? ~0ULL : (1ULL << rows) - 1;
+    
+    if(board->minBust <= 1) {
+        return columns > 0 && rows > 0;
+    }
+    
+    // any two matching neighbours make a move when pairs are enough. a cell
+    // matches the one above (or to its right) when no plane differs
+    if(board->minBust == 2) {
+        for(int c=0; c<columns; c++) {
+            uint64_t up = 0;
+            uint64_t right = 0;
+            
+            for(int p=0; p<PACKED_BOARD_PLANES; p++) {
+                up |= board->planes[c][p] ^ (board->planes[c][p] >> 1);
+                if(c+1 < columns) {
+                    right |= board->planes[c][p] ^ board->planes[c+1][p];
+                }
+            }
+            
+            if(~up & (rowMask >> 1)) return 1;
+            if(c+1 < columns && (~right & rowMask)) return 1;
+        }
+        return 0;
+    }
+    
+    // otherwise flood every cluster until one is big enough
+    uint64_t seen[BOARD_MAX_COLUMNS];
+    memset(seen, 0, sizeof(seen));
+    
+    for(int color=0; color<board->colorCount; color++) {
+        uint64_t masks[BOARD_MAX_COLUMNS];
+        KBPackedColorMasks(board, columns, color, masks);
+        
+        for(int c=0; c<columns; c++) {
+            for(uint64_t bits=masks[c] & ~seen[c]; bits; bits=masks[c] & ~seen[c]) {
+                uint64_t region[BOARD_MAX_COLUMNS];
+                int first, last;
+                
+                if(KBPackedFloodCluster(columns, rows, masks, c, __builtin_ctzll(bits), region, &first, &last) >= board->minBust) {
+                    return 1;
+                }
+                
+                for(int r=first; r<=last; r++) {
+                    seen[r] |= region[r];
+                }
+            }
+        }
+    }
+    
+    return 0;
+}
+
+static void KBPackedReshuffle(KBPackedBoard *board);
+
+KB_KERNEL int KBPackedTapKernel(KBPackedBoard *board, int columns, int rows, int column, int row)
+{
+    if(column < 0 || column >= columns || row < 0 || row >= rows) {
+        return 0;
+    }
+    
+    uint64_t masks[BOARD_MAX_COLUMNS];
+    uint64_t region[BOARD_MAX_COLUMNS];
+    int first, last;
+    
+    KBPackedColorMasks(board, columns, KBPackedBoardColorAt(board, column, row), masks);
+    int size = KBPackedFloodCluster(columns, rows, masks, column, row, region, &first, &last);
+    
+    // a cluster too small to bust leaves the board untouched
+    if(size < board->minBust) {
+        return 0;
+    }
+    
+    // let the remaining blocks in each column fall, and refill from the top
+    for(int c=first; c<=last; c++) {
+        if(region[c] == 0) {
+            continue;
+        }
+        
+        for(int p=0; p<PACKED_BOARD_PLANES; p++) {
+            board->planes[c][p] = KBPackedCompact(board->planes[c][p], region[c]);
+        }
+        
+        int spawned = __builtin_popcountll(region[c]);
+        for(int r=rows-spawned; r<rows; r++) {
+            KBPackedSet(board, c, r, KBRefillColor(board->refillSeed, board->colorCount, c, board->dropped[c]++));
+        }
+    }
+    
+    if(!KBPackedHasMoveKernel(board, columns, rows)) {
+        KBPackedReshuffle(board);
+    }
+    
+    return size;
+}
+
+// a copy of the rules for every board size a game mode ships with, with the
+// size baked in, plus the generic one that reads it from the board
+struct KBPackedBoardKernel {
+    int columns;
+    int rows;
+    int (*clusterSize)(const KBPackedBoard *board, int column, int row);
+    int (*hasMove)(const KBPackedBoard *board);
+    int (*tap)(KBPackedBoard *board, int column, int row);
+};
+
+#define PACKED_BOARD_KERNEL(COLUMNS, ROWS) \
+    static int KBPackedClusterSize_##COLUMNS##x##ROWS(const KBPackedBoard *board, int column, int row) \
+        { return KBPackedClusterSizeKernel(board, COLUMNS, ROWS, column, row); } \
+    static int KBPackedHasMove_##COLUMNS##x##ROWS(const KBPackedBoard *board) \
+        { return KBPackedHasMoveKernel(board, COLUMNS, ROWS); } \
+    static int KBPackedTap_##COLUMNS##x##ROWS(KBPackedBoard *board, int column, int row) \
+        { return KBPackedTapKernel(board, COLUMNS, ROWS, column, row); }
+
+#define PACKED_BOARD_KERNEL_ENTRY(COLUMNS, ROWS) \
+    { COLUMNS, ROWS, KBPackedClusterSize_##COLUMNS##x##ROWS, KBPackedHasMove_##COLUMNS##x##ROWS, KBPackedTap_##COLUMNS##x##ROWS }
+
+// the sizes of the modes in GameModes.json
+PACKED_BOARD_KERNEL(6, 7)
+PACKED_BOARD_KERNEL(8, 8)
+PACKED_BOARD_KERNEL(12, 16)
+
+static int KBPackedClusterSize_generic(const KBPackedBoard *board, int column, int row)
+{
+    return KBPackedClusterSizeKernel(board, board->columns, board->rows, column, row);
+}
+
+static int KBPackedHasMove_generic(const KBPackedBoard *board)
+{
+    return KBPackedHasMoveKernel(board, board->columns, board->rows);
+}
+
+static int KBPackedTap_generic(KBPackedBoard *board, int column, int row)
+{
+    return KBPackedTapKernel(board, board->columns, board->rows, column, row);
+}
+
+static const KBPackedBoardKernel kernels[] = {
+    PACKED_BOARD_KERNEL_ENTRY(6, 7),
+    PACKED_BOARD_KERNEL_ENTRY(8, 8),
+    PACKED_BOARD_KERNEL_ENTRY(12, 16),
+};
+
+static const KBPackedBoardKernel genericKernel = {
+    0, 0, KBPackedClusterSize_generic, KBPackedHasMove_generic, KBPackedTap_generic
+};
+
+int KBPackedBoardClusterSize(const KBPackedBoard *board, int column, int row)
+{
+    return board->kernel->clusterSize(board, column, row);
+}
+
+int KBPackedBoardHasMove(const KBPackedBoard *board)
+{
+    return board->kernel->hasMove(board);
+}
+
+// unpack into cells laid out like KBBoard's, and back
+static void KBPackedUnpack(const KBPackedBoard *board, uint8_t *cells)
+{
+    for(int c=0; c<board->columns; c++) {
+        for(int r=0; r<board->rows; r++) {
+            cells[BOARD_INDEX(c, r)] = (uint8_t)KBPackedBoardColorAt(board, c, r);
+        }
+    }
+}
+
+static void KBPackedPack(KBPackedBoard *board, const uint8_t *cells)
+{
+    memset(board->planes, 0, sizeof(board->planes));
+    
+    for(int c=0; c<board->columns; c++) {
+        for(int r=0; r<board->rows; r++) {
+            KBPackedSet(board, c, r, cells[BOARD_INDEX(c, r)]);
+        }
+    }
+}
+
+// the same steps as KBBoardReshuffle, so the same random numbers give the same board
+static void KBPackedReshuffle(KBPackedBoard *board)
+{
+    uint8_t cells[BOARD_MAX_CELLS];
+    KBPackedUnpack(board, cells);
+    
+    for(int attempt=0; attempt<BOARD_SHUFFLE_ATTEMPTS; attempt++) {
+        KBBoardShuffleCells(cells, board->columns, board->rows, &board->random);
+        KBPackedPack(board, cells);
+        
+        if(KBPackedBoardHasMove(board)) {
+            return;
+        }
+    }
+    
+    KBBoardForceMove(cells, board->columns, board->rows, board->minBust);
+    KBPackedPack(board, cells);
+}
+
+static void KBPackedSetup(KBPackedBoard *board, int columns, int rows, int colorCount, int minBust)
+{
+    memset(board, 0, sizeof(KBPackedBoard));
+    
+    board->columns = columns;
+    board->rows = rows;
+    board->colorCount = colorCount;
+    board->minBust = minBust;
+    board->rowMask = (rows >= 64) ? ~0ULL : (1ULL << rows) - 1;
+    
+    // use the rules made for this size if there are any
+    board->kernel = &genericKernel;
+    for(size_t k=0; k<sizeof(kernels)/sizeof(kernels[0]); k++) {
+        if(kernels[k].columns == columns && kernels[k].rows == rows) {
+            board->kernel = &kernels[k];
+        }
+    }
+}
+
+int KBPackedBoardInit(KBPackedBoard *board, int columns, int rows, int colorCount, int minBust, uint64_t seed)
+{
+    if(colorCount > PACKED_BOARD_MAX_COLORS) {
+        return 0;
+    }
+    
+    KBPackedSetup(board, columns, rows, colorCount, minBust);
+    
+    // the same random numbers in the same order as KBBoardInit
+    KBRandomSeed(&board->random, seed);
+    board->refillSeed = KBMix(seed ^ 0x5DEECE66DULL);
+    
+    for(int row=0; row<rows; row++) {
+        for(int col=0; col<columns; col++) {
+            KBPackedSet(board, col, row, KBRandomBelow(&board->random, colorCount));
+        }
+    }
+    
+    if(!KBPackedBoardHasMove(board)) {
+        KBPackedReshuffle(board);
+    }
+    
+    return 1;
+}
+
+int KBPackedBoardFromBoard(KBPackedBoard *packed, const KBBoard *board)
+{
+    if(board->colorCount > PACKED_BOARD_MAX_COLORS) {
+        return 0;
+    }
+    
+    KBPackedSetup(packed, board->columns, board->rows, board->colorCount, board->minBust);
+    
+    packed->random = board->random;
+    packed->refillSeed = board->refillSeed;
+    memcpy(packed->dropped, board->dropped, board->columns * sizeof(uint32_t));
+    KBPackedPack(packed, board->cells);
+    
+    return 1;
+}
+
+void KBPackedBoardSetRefillSeed(KBPackedBoard *board, uint64_t seed)
+{
+    board->refillSeed = seed;
+    memset(board->dropped, 0, sizeof(board->dropped));
+}
+
+int KBPackedBoardTap(KBPackedBoard *board, int column, int row)
+{
+    return board->kernel->tap(board, column, row);
+}
@@ -0,0 +1,113 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#ifndef KiiBlocks_PackedBoard_h
+#define KiiBlocks_PackedBoard_h
+
+#include "Board.h"
+
+// the board squeezed down for simulation (replays, solvers, the auto-player).
+// colors are stored as bit planes: for every column there is one 64-bit word
+// per bit of the color, with bit r of the word belonging to row r. even a
+// 64x64 board is only 1.5KB, so it sits in L1 the whole time, and the rules
+// become whole-column bit operations - a cluster is flooded a column at a
+// time and gravity is a bit extract (pext on cpus with BMI2).
+//
+// it plays by exactly the same rules as KBBoard - the same starting blocks,
+// refills and reshuffles for the same seed - but keeps no labels or hash,
+// so cluster sizes are worked out when asked for
+
+// up to 8 colors fit in 3 bits
+#define PACKED_BOARD_PLANES     3
+#define PACKED_BOARD_MAX_COLORS (1 << PACKED_BOARD_PLANES)
+
+// the rules specialized for one board size (see PackedBoard.c)
+typedef struct KBPackedBoardKernel KBPackedBoardKernel;
+
+typedef struct {
+    int columns;
+    int rows;
+    int colorCount;
+    int minBust;
+    
+    // a bit for every row the board has
+    uint64_t rowMask;
+    
+    // the rules to play this board with, picked by its size
+    const KBPackedBoardKernel *kernel;
+    
+    // the same random numbers and block streams as KBBoard
+    KBRandom random;
+    uint64_t refillSeed;
+    uint32_t dropped[BOARD_MAX_COLUMNS];
+    
+    // bit plane p of column c holds bit p of the color of every cell in the column
+    uint64_t planes[BOARD_MAX_COLUMNS][PACKED_BOARD_PLANES];
+} KBPackedBoard;
+
+// set up a board exactly like KBBoardInit would. returns FALSE if the board
+// has more colors than we can pack
+int KBPackedBoardInit(KBPackedBoard *board, int columns, int rows, int colorCount, int minBust, uint64_t seed);
+
+// pack up an existing board, mid-game (FALSE if it has too many colors)
+int KBPackedBoardFromBoard(KBPackedBoard *packed, const KBBoard *board);
+
+// the same as KBBoardSetRefillSeed
+void KBPackedBoardSetRefillSeed(KBPackedBoard *board, uint64_t seed);
+
+static inline int KBPackedBoardColorAt(const KBPackedBoard *board, int column, int row)
+{
+    int color = 0;
+    for(int p=0; p<PACKED_BOARD_PLANES; p++) {
+        color |= (int)((board->planes[column][p] >> row) & 1) << p;
+    }
+    return color;
+}
+
+// the cells of a column that have the given color, one bit per row
+static inline uint64_t KBPackedBoardColorMask(const KBPackedBoard *board, int column, int color)
+{
+    uint64_t mask = board->rowMask;
+    for(int p=0; p<PACKED_BOARD_PLANES; p++) {
+        mask &= ((color >> p) & 1) ? board->planes[column][p] : ~board->planes[column][p];
+    }
+    return mask;
+}
+
+// how many blocks of a color are on the board
+static inline int KBPackedBoardColorCount(const KBPackedBoard *board, int color)
+{
+    int count = 0;
+    for(int c=0; c<board->columns; c++) {
+        count += __builtin_popcountll(KBPackedBoardColorMask(board, c, color));
+    }
+    return count;
+}
+
+// the size of the cluster a cell belongs to (a flood fill - not free like KBBoard's)
+int KBPackedBoardClusterSize(const KBPackedBoard *board, int column, int row);
+
+// true if any cluster can be busted
+int KBPackedBoardHasMove(const KBPackedBoard *board);
+
+// tap a cell, exactly like KBBoardTap. returns the number of blocks removed
+int KBPackedBoardTap(KBPackedBoard *board, int column, int row);
+
+#endif
@@ -0,0 +1,81 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#ifndef KiiBlocks_Replay_h
+#define KiiBlocks_Replay_h
+
+#include <stdint.h>
+#include "Scoring.h"
+
+// the record of one game: how the board was set up, every tap and when it
+// happened, and the score the player says they got. replaying the taps on a
+// board built from the same seed has to come out at the same score.
+//
+// records are stored back to back - a header, the game's scoring rules if it
+// had any of its own, and its taps - with every field little-endian, so a
+// day's worth of them can be read straight out of a memory-mapped file
+
+#define REPLAY_MAGIC    0x3152424B      // "KBR1"
+
+typedef struct {
+    uint32_t magic;
+    uint8_t columns;
+    uint8_t rows;
+    uint8_t colorCount;
+    uint8_t minBust;
+    uint64_t seed;
+    uint32_t timeLimitMillis;
+    uint32_t claimedScore;
+    uint32_t tapCount;
+    
+    // the size of the scoring rules after the header: sizeof(KBScoringRules),
+    // or 0 for a game scored a point a block (records from before modes had
+    // scoring rules all are)
+    uint32_t rulesSize;
+} KBReplayHeader;
+
+typedef struct {
+    
+    // when the tap happened, counted from the start of the game
+    uint32_t millis;
+    
+    uint8_t column;
+    uint8_t row;
+    uint16_t reserved;
+} KBReplayTap;
+
+// the size of a whole record
+static inline uint64_t KBReplayRecordSize(const KBReplayHeader *header)
+{
+    return sizeof(KBReplayHeader) + header->rulesSize + (uint64_t)header->tapCount * sizeof(KBReplayTap);
+}
+
+// the scoring rules of a record (NULL if it has none), and its taps
+static inline const KBScoringRules *KBReplayRules(const KBReplayHeader *header)
+{
+    return header->rulesSize ? (const KBScoringRules*)(header + 1) : NULL;
+}
+
+static inline const KBReplayTap *KBReplayTaps(const KBReplayHeader *header)
+{
+    return (const KBReplayTap*)((const uint8_t*)(header + 1) + header->rulesSize);
+}
+
+#endif
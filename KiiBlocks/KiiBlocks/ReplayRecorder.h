@@ -0,0 +1,50 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+@class GameMode;
+
+// writes down a game as it's played, in the record format of Replay.h, so
+// the validator can play it back and check the score. a replay only makes
+// sense for a game that started from a freshly seeded board - one carried on
+// from a snapshot isn't recorded
+@interface ReplayRecorder : NSObject
+
+// TRUE between begin and finish (or discard)
+@property (nonatomic, readonly) BOOL recording;
+
+// the number of taps recorded so far
+@property (nonatomic, readonly) NSUInteger tapCount;
+
+// start a new record for a board set up by KBBoardInit with this seed
+- (void) beginWithMode:(GameMode*)mode seed:(uint64_t)seed;
+
+// note a tap, in milliseconds since the game started. taps come in the
+// order they were resolved in, which is the order they're played back in
+- (void) recordTapAtColumn:(int)column row:(int)row millis:(uint32_t)millis;
+
+// the whole record with the score the game ended on, or nil if nothing was
+// being recorded. stops recording
+- (NSData*) finishWithScore:(NSUInteger)score;
+
+// stop recording and throw the record away
+- (void) discard;
+
+@end
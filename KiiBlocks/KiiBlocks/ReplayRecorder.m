@@ -0,0 +1,133 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "ReplayRecorder.h"
+#import "GameMode.h"
+#import "Replay.h"
+
+@interface ReplayRecorder() {
+    KBReplayHeader _header;
+    
+    // the mode's scoring rules, already little-endian (only written out if
+    // they're not the plain point a block)
+    KBScoringRules _rules;
+    
+    // the taps so far, already little-endian
+    NSMutableData *_taps;
+    
+    uint32_t _lastMillis;
+}
+
+@end
+
+@implementation ReplayRecorder
+
+- (NSUInteger) tapCount
+{
+    return _taps.length / sizeof(KBReplayTap);
+}
+
+- (void) beginWithMode:(GameMode*)mode seed:(uint64_t)seed
+{
+    memset(&_header, 0, sizeof(_header));
+    _header.magic = OSSwapHostToLittleInt32(REPLAY_MAGIC);
+    _header.columns = (uint8_t)mode.columns;
+    _header.rows = (uint8_t)mode.rows;
+    _header.colorCount = (uint8_t)mode.colorCount;
+    _header.minBust = (uint8_t)mode.minBust;
+    _header.seed = OSSwapHostToLittleInt64(seed);
+    _header.timeLimitMillis = OSSwapHostToLittleInt32((uint32_t)(mode.timeLimit * 1000));
+    
+    KBScoringRules plain;
+    KBScoringRulesDefault(&plain);
+    [mode getScoringRules:&_rules];
+    
+    if(memcmp(&_rules, &plain, sizeof(plain)) != 0) {
+        _header.rulesSize = OSSwapHostToLittleInt32((uint32_t)sizeof(KBScoringRules));
+        
+        _rules.stepCount = OSSwapHostToLittleInt32(_rules.stepCount);
+        for(int i=0; i<SCORING_MAX_STEPS; i++) {
+            _rules.steps[i] = OSSwapHostToLittleInt32(_rules.steps[i]);
+        }
+        for(int i=0; i<SCORING_MAX_COLORS; i++) {
+            _rules.colorPercent[i] = OSSwapHostToLittleInt16(_rules.colorPercent[i]);
+        }
+        _rules.chainWindowMillis = OSSwapHostToLittleInt32(_rules.chainWindowMillis);
+        _rules.chainCount = OSSwapHostToLittleInt32(_rules.chainCount);
+        for(int i=0; i<SCORING_MAX_CHAIN; i++) {
+            _rules.chainPercent[i] = OSSwapHostToLittleInt16(_rules.chainPercent[i]);
+        }
+        _rules.colorClearBonus = OSSwapHostToLittleInt32(_rules.colorClearBonus);
+    }
+    
+    // a minute of furious tapping fits without growing
+    _taps = [NSMutableData dataWithCapacity:256 * sizeof(KBReplayTap)];
+    _lastMillis = 0;
+    _recording = TRUE;
+}
+
+- (void) recordTapAtColumn:(int)column row:(int)row millis:(uint32_t)millis
+{
+    if(!_recording) {
+        return;
+    }
+    
+    // taps resolved together can straddle the start of the clock - the
+    // playback only wants to see time go forward
+    millis = MAX(millis, _lastMillis);
+    _lastMillis = millis;
+    
+    KBReplayTap tap;
+    memset(&tap, 0, sizeof(tap));
+    tap.millis = OSSwapHostToLittleInt32(millis);
+    tap.column = (uint8_t)column;
+    tap.row = (uint8_t)row;
+    
+    [_taps appendBytes:&tap length:sizeof(tap)];
+}
+
+- (NSData*) finishWithScore:(NSUInteger)score
+{
+    if(!_recording) {
+        return nil;
+    }
+    
+    // the game's total never goes past the largest score a record can claim,
+    // but don't let a bigger one wrap round to a small one if it ever did
+    _header.claimedScore = OSSwapHostToLittleInt32((score < UINT32_MAX) ? (uint32_t)score : UINT32_MAX);
+    _header.tapCount = OSSwapHostToLittleInt32((uint32_t)self.tapCount);
+    
+    uint32_t rulesSize = OSSwapLittleToHostInt32(_header.rulesSize);
+    
+    NSMutableData *record = [NSMutableData dataWithCapacity:sizeof(_header) + rulesSize + _taps.length];
+    [record appendBytes:&_header length:sizeof(_header)];
+    [record appendBytes:&_rules length:rulesSize];
+    [record appendData:_taps];
+    
+    [self discard];
+    return record;
+}
+
+- (void) discard
+{
+    _taps = nil;
+    _recording = FALSE;
+}
+
+@end
@@ -0,0 +1,44 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+// the number of shards the server spreads the score sketch over (matches SKETCH_SHARDS)
+#define SCORE_SKETCH_SHARDS     8
+
+// where a score stands among everyone's, from the score sketch the server
+// code keeps up to date (see ScoreSketch.h). the whole thing is a handful of
+// small objects read in one query, however many scores there are
+@interface ScoreDistribution : NSObject
+
+// TRUE once the sketch has been fetched
+@property (nonatomic, readonly) BOOL loaded;
+
+// how many scores the sketch has seen
+@property (nonatomic, readonly) uint64_t count;
+
++ (ScoreDistribution*) sharedDistribution;
+
+// fetch the shards of the sketch and merge them
+- (void) refreshWithBlock:(void (^)(NSError *error))block;
+
+// the fraction of all scores better than this one (0.032 is 'top 3.2%')
+- (double) fractionAbove:(NSUInteger)score;
+
+@end
@@ -0,0 +1,128 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "ScoreDistribution.h"
+#import "ScoreSketch.h"
+#import "MemoryBudget.h"
+
+@interface ScoreDistribution() {
+    
+    // allocated when the sketch is first fetched, and let go when memory is short
+    KBScoreSketch *_sketch;
+}
+
+@end
+
+@implementation ScoreDistribution
+
++ (ScoreDistribution*) sharedDistribution
+{
+    static ScoreDistribution *sharedDistribution = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedDistribution = [[ScoreDistribution alloc] init];
+    });
+    return sharedDistribution;
+}
+
+- (id) init
+{
+    self = [super init];
+    
+    if(self) {
+        
+        // the sketch is read again (one query) the next time the leaderboard is shown
+        __weak ScoreDistribution *distribution = self;
+        [[MemoryBudget sharedBudget] registerCache:@"scoreSketch"
+                                              tier:MemoryTierCheap
+                                         footprint:^NSUInteger {
+            return distribution.loaded ? sizeof(KBScoreSketch) : 0;
+        }
+                                             evict:^{
+            [distribution unload];
+        }];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    free(_sketch);
+}
+
+- (void) unload
+{
+    free(_sketch);
+    _sketch = NULL;
+    _loaded = FALSE;
+}
+
+- (uint64_t) count
+{
+    return (_sketch != NULL) ? _sketch->count : 0;
+}
+
+- (void) refreshWithBlock:(void (^)(NSError *error))block
+{
+    NSMutableArray *boards = [NSMutableArray arrayWithCapacity:SCORE_SKETCH_SHARDS];
+    for(int i=0; i<SCORE_SKETCH_SHARDS; i++) {
+        [boards addObject:[NSString stringWithFormat:@"sketch:%d", i]];
+    }
+    
+    KiiQuery *query = [KiiQuery queryWithClause:[KiiClause in:@"board" value:boards]];
+    [query setLimit:SCORE_SKETCH_SHARDS];
+    
+    [[Kii bucketWithName:@"leaderboard"] executeQuery:query
+                                            withBlock:^(KiiQuery *query, KiiBucket *bucket, NSArray *results, KiiQuery *nextQuery, NSError *error) {
+        
+        if(error == nil) {
+            
+            // the shards just add up. each stores the span of buckets it uses,
+            // starting at bucket 'o'
+            if(_sketch == NULL) {
+                _sketch = malloc(sizeof(KBScoreSketch));
+            }
+            KBScoreSketchInit(_sketch);
+            
+            for(KiiObject *shard in results) {
+                NSInteger offset = [[shard getObjectForKey:@"o"] integerValue];
+                NSArray *counts = [shard getObjectForKey:@"c"];
+                
+                for(NSUInteger i=0; i<counts.count && offset+i < SCORE_SKETCH_BUCKETS; i++) {
+                    _sketch->buckets[offset+i] += [[counts objectAtIndex:i] unsignedLongLongValue];
+                }
+                
+                _sketch->zeroCount += [[shard getObjectForKey:@"z"] unsignedLongLongValue];
+                _sketch->count += [[shard getObjectForKey:@"n"] unsignedLongLongValue];
+            }
+            
+            _loaded = TRUE;
+        }
+        
+        if(block) block(error);
+    }];
+}
+
+- (double) fractionAbove:(NSUInteger)score
+{
+    return (_sketch != NULL) ? KBScoreSketchFractionAbove(_sketch, score) : 0;
+}
+
+@end
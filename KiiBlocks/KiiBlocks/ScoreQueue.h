@@ -0,0 +1,42 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+
+// scores on their way to the cloud. a finished game's score is written to
+// disk and the game moves straight on to the leaderboard, while the score is
+// sent in the background. anything that doesn't make it - no network, an
+// expired session, the app being killed - stays queued and is sent the next
+// time the queue is flushed (when a score is added, and when the app becomes
+// active)
+@interface ScoreQueue : NSObject
+
+// how many scores are still waiting to go up
+@property (nonatomic, readonly) NSUInteger count;
+
++ (ScoreQueue*) sharedQueue;
+
+// queue a score for the current session's player (along with where it was
+// played, if we know, and the game's replay, if it was recorded) and start sending
+- (void) addScore:(NSUInteger)score withReplay:(NSData*)replay;
+
+// send whatever is queued for the current player, oldest first
+- (void) flush;
+
+@end
@@ -0,0 +1,214 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "ScoreQueue.h"
+#import "CloudSession.h"
+#import "LocationTracker.h"
+#import "GeoCell.h"
+
+@interface ScoreQueue() {
+    
+    // the scores waiting to go up, as dictionaries - mirrored in scorequeue.plist
+    NSMutableArray *_scores;
+    
+    NSString *_path;
+    BOOL _flushing;
+}
+
+@end
+
+@implementation ScoreQueue
+
++ (ScoreQueue*) sharedQueue
+{
+    static ScoreQueue *sharedQueue = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedQueue = [[ScoreQueue alloc] init];
+    });
+    return sharedQueue;
+}
+
+- (id) init
+{
+    self = [super init];
+    
+    if(self) {
+        NSString *documents = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, TRUE) lastObject];
+        _path = [documents stringByAppendingPathComponent:@"scorequeue.plist"];
+        
+        _scores = [NSMutableArray array];
+        
+        // scores queued by an older version have no client id yet, and may
+        // hold where exactly they were played - give them an id, so they can't
+        // go up twice either, and keep no more than the cell
+        for(NSDictionary *queued in [NSArray arrayWithContentsOfFile:_path]) {
+            NSMutableDictionary *entry = [queued mutableCopy];
+            
+            if([entry objectForKey:@"clientID"] == nil) {
+                [entry setObject:[[NSUUID UUID] UUIDString] forKey:@"clientID"];
+            }
+            if([entry objectForKey:@"latitude"] != nil) {
+                [entry setObject:[GeoCell cellForLatitude:[[entry objectForKey:@"latitude"] doubleValue]
+                                             andLongitude:[[entry objectForKey:@"longitude"] doubleValue]]
+                          forKey:@"geocell"];
+                [entry removeObjectForKey:@"latitude"];
+                [entry removeObjectForKey:@"longitude"];
+            }
+            
+            [_scores addObject:entry];
+        }
+    }
+    
+    return self;
+}
+
+- (NSUInteger) count
+{
+    return _scores.count;
+}
+
+- (void) save
+{
+    [_scores writeToFile:_path atomically:TRUE];
+}
+
+- (void) addScore:(NSUInteger)score withReplay:(NSData*)replay
+{
+    CloudSession *session = [CloudSession sharedSession];
+    
+    // a score can only be queued for a known player - it could never be sent
+    if(session.username == nil || session.userID == nil) {
+        NSLog(@"Unable to queue score %lu, nobody is logged in", (unsigned long)score);
+        return;
+    }
+    
+    // everything the score object needs is taken now - by the time it's sent
+    // the player may have moved on (or logged in as somebody else). the
+    // client id goes up with the score, so if a save reaches the server but
+    // its reply doesn't reach us, the server drops the copy we send again
+    NSMutableDictionary *entry = [NSMutableDictionary dictionary];
+    [entry setObject:[[NSUUID UUID] UUIDString] forKey:@"clientID"];
+    [entry setObject:@(score) forKey:@"score"];
+    [entry setObject:session.username forKey:@"username"];
+    
+    // who the score is for stays here - the server takes the player from
+    // the session the score is saved under
+    [entry setObject:session.userID forKey:@"userID"];
+    
+    // only the regional leaderboard cell the player was in is kept (and
+    // sent) - scores can be read by every player, where exactly they were can't
+    CLLocation *location = [LocationTracker sharedTracker].lastLocation;
+    if(location != nil) {
+        [entry setObject:[GeoCell cellForLatitude:location.coordinate.latitude
+                                     andLongitude:location.coordinate.longitude]
+                  forKey:@"geocell"];
+    }
+    
+    if(replay != nil) {
+        [entry setObject:replay forKey:@"replay"];
+    }
+    
+    [_scores addObject:entry];
+    [self save];
+    
+    [self flush];
+}
+
+- (void) flush
+{
+    if(_flushing || _scores.count == 0) {
+        return;
+    }
+    _flushing = TRUE;
+    
+    // scores can only go up under the session of the player who made them
+    [[CloudSession sharedSession] authenticateWithBlock:^(NSError *error) {
+        if(error != nil) {
+            _flushing = FALSE;
+            return;
+        }
+        [self sendNext];
+    }];
+}
+
+// send the current player's oldest score, and the rest of theirs after it
+// one at a time
+- (void) sendNext
+{
+    CloudSession *session = [CloudSession sharedSession];
+    
+    // scores that belong to somebody else are skipped, and wait in the queue
+    // until they log in again
+    NSDictionary *entry = nil;
+    for(NSDictionary *queued in _scores) {
+        if([[queued objectForKey:@"userID"] isEqualToString:session.userID]) {
+            entry = queued;
+            break;
+        }
+    }
+    
+    if(entry == nil) {
+        _flushing = FALSE;
+        return;
+    }
+    
+    // create their score as a KiiObject
+    KiiObject *scoreObject = [[Kii bucketWithName:@"scores"] createObject];
+    
+    // the server keeps only the first score saved with a client id
+    [scoreObject setObject:[entry objectForKey:@"clientID"] forKey:@"clientID"];
+    
+    // fill the object with the score and username
+    [scoreObject setObject:[entry objectForKey:@"score"] forKey:@"score"];
+    [scoreObject setObject:[entry objectForKey:@"username"] forKey:@"username"];
+    
+    // tag the score with the cell it was played in so the server can file it under a regional leaderboard
+    if([entry objectForKey:@"geocell"] != nil) {
+        [scoreObject setObject:[entry objectForKey:@"geocell"] forKey:@"geocell"];
+    }
+    
+    // the replay goes along so the score can be checked (see Tools/validate.c)
+    NSData *replay = [entry objectForKey:@"replay"];
+    if(replay != nil) {
+        [scoreObject setObject:[replay base64EncodedStringWithOptions:0] forKey:@"replay"];
+    }
+    
+    // save the score to the cloud bucket "scores"
+    [scoreObject saveWithBlock:^(KiiObject *object, NSError *error) {
+        
+        if(error == nil) {
+            [_scores removeObjectIdenticalTo:entry];
+            [self save];
+            [self sendNext];
+            return;
+        }
+        
+        // the session has run out under us. the score stays queued, and the
+        // player is asked to log in again at the end of the next game
+        if([CloudSession isUnauthorizedError:error]) {
+            [session invalidateSession];
+        }
+        
+        NSLog(@"Unable to send score, %lu still queued: %@", (unsigned long)_scores.count, error);
+        _flushing = FALSE;
+    }];
+}
+
+@end
@@ -0,0 +1,110 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#include "ScoreSketch.h"
+
+#include <math.h>
+#include <string.h>
+
+void KBScoreSketchInit(KBScoreSketch *sketch)
+{
+    memset(sketch, 0, sizeof(KBScoreSketch));
+}
+
+int KBScoreSketchIndex(double value)
+{
+    // written exactly as the server code does it, so both sides agree on the
+    // bucket even for scores right on an edge
+    int index = (int)ceil(log(value) / log(SCORE_SKETCH_GAMMA));
+    
+    return (index < 0) ? 0 : (index >= SCORE_SKETCH_BUCKETS ? SCORE_SKETCH_BUCKETS-1 : index);
+}
+
+double KBScoreSketchValue(int index)
+{
+    // halfway between the edges, relative to their size
+    return 2 * pow(SCORE_SKETCH_GAMMA, index) / (SCORE_SKETCH_GAMMA + 1);
+}
+
+void KBScoreSketchAdd(KBScoreSketch *sketch, double value)
+{
+    if(value < 1) {
+        ++sketch->zeroCount;
+    } else {
+        ++sketch->buckets[KBScoreSketchIndex(value)];
+    }
+    ++sketch->count;
+}
+
+void KBScoreSketchMerge(KBScoreSketch *sketch, const KBScoreSketch *other)
+{
+    for(int i=0; i<SCORE_SKETCH_BUCKETS; i++) {
+        sketch->buckets[i] += other->buckets[i];
+    }
+    sketch->zeroCount += other->zeroCount;
+    sketch->count += other->count;
+}
+
+double KBScoreSketchQuantile(const KBScoreSketch *sketch, double fraction)
+{
+    if(sketch->count == 0) {
+        return 0;
+    }
+    
+    // the rank of the score we're after, counting from 0
+    uint64_t rank = (uint64_t)(fraction * (sketch->count - 1));
+    
+    if(rank < sketch->zeroCount) {
+        return 0;
+    }
+    
+    uint64_t seen = sketch->zeroCount;
+    for(int i=0; i<SCORE_SKETCH_BUCKETS; i++) {
+        seen += sketch->buckets[i];
+        if(seen > rank) {
+            return KBScoreSketchValue(i);
+        }
+    }
+    
+    return KBScoreSketchValue(SCORE_SKETCH_BUCKETS-1);
+}
+
+double KBScoreSketchFractionAbove(const KBScoreSketch *sketch, double value)
+{
+    if(sketch->count == 0) {
+        return 0;
+    }
+    
+    uint64_t above = 0;
+    uint64_t same;
+    
+    if(value < 1) {
+        same = sketch->zeroCount;
+        above = sketch->count - sketch->zeroCount;
+    } else {
+        int index = KBScoreSketchIndex(value);
+        
+        same = sketch->buckets[index];
+        for(int i=index+1; i<SCORE_SKETCH_BUCKETS; i++) {
+            above += sketch->buckets[i];
+        }
+    }
+    
+    return (above + same / 2.0) / sketch->count;
+}
@@ -0,0 +1,70 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#ifndef KiiBlocks_ScoreSketch_h
+#define KiiBlocks_ScoreSketch_h
+
+#include <stdint.h>
+
+// a mergeable summary of every score ever submitted, good for telling a
+// player roughly where they stand ('top 3.2%') without counting the scores
+// above theirs. scores are counted in logarithmic buckets (as in DDSketch):
+// bucket i holds the scores in (gamma^(i-1), gamma^i], so any value read back
+// is within SCORE_SKETCH_ACCURACY of the real one, and two sketches merge by
+// adding their buckets. the server code keeps the same layout (kiiblocks.js)
+
+// the relative accuracy of the values read back
+#define SCORE_SKETCH_ACCURACY   0.01
+#define SCORE_SKETCH_GAMMA      ((1 + SCORE_SKETCH_ACCURACY) / (1 - SCORE_SKETCH_ACCURACY))
+
+// enough buckets for scores up to about 800 million. the highest one also
+// takes anything bigger than that
+#define SCORE_SKETCH_BUCKETS    1024
+
+typedef struct {
+    
+    // how many scores there are, and how many of those were below 1
+    uint64_t count;
+    uint64_t zeroCount;
+    
+    uint64_t buckets[SCORE_SKETCH_BUCKETS];
+} KBScoreSketch;
+
+void KBScoreSketchInit(KBScoreSketch *sketch);
+
+// the bucket a score of at least 1 goes in
+int KBScoreSketchIndex(double value);
+
+// the value standing in for everything in a bucket - within the accuracy of all of them
+double KBScoreSketchValue(int index);
+
+void KBScoreSketchAdd(KBScoreSketch *sketch, double value);
+
+// fold another sketch into this one
+void KBScoreSketchMerge(KBScoreSketch *sketch, const KBScoreSketch *other);
+
+// the (approximate) score below which the given fraction of scores fall
+double KBScoreSketchQuantile(const KBScoreSketch *sketch, double fraction);
+
+// the fraction of scores above the given one. the scores sharing its bucket
+// are counted as half above and half below, so the answer is off by at most
+// half of that bucket's share
+double KBScoreSketchFractionAbove(const KBScoreSketch *sketch, double value);
+
+#endif
@@ -0,0 +1,83 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#include "Scoring.h"
+
+#include <string.h>
+
+void KBScoringRulesDefault(KBScoringRules *rules)
+{
+    memset(rules, 0, sizeof(KBScoringRules));
+    
+    for(int c=0; c<SCORING_MAX_COLORS; c++) {
+        rules->colorPercent[c] = 100;
+    }
+}
+
+void KBScoringTablesBuild(KBScoringTables *tables, const KBScoringRules *rules, int columns, int rows)
+{
+    uint32_t stepCount = (rules->stepCount < SCORING_MAX_STEPS) ? rules->stepCount : SCORING_MAX_STEPS;
+    uint32_t chainCount = (rules->chainCount < SCORING_MAX_CHAIN) ? rules->chainCount : SCORING_MAX_CHAIN;
+    
+    tables->largestCluster = columns * rows;
+    tables->chainWindowMillis = rules->chainWindowMillis;
+    tables->colorClearBonus = rules->colorClearBonus;
+    
+    // no chain list means every clear counts the same
+    if(chainCount == 0) {
+        tables->chainLinks = 1;
+        tables->chainPercent[0] = 100;
+    } else {
+        tables->chainLinks = chainCount;
+        for(uint32_t n=0; n<chainCount; n++) {
+            tables->chainPercent[n] = rules->chainPercent[n];
+        }
+    }
+    
+    // the size curve first, in the first color's row
+    uint32_t *curve = tables->points[0];
+    for(int size=0; size<=tables->largestCluster; size++) {
+        if(stepCount == 0) {
+            curve[size] = (uint32_t)size;
+        } else if((uint32_t)size < stepCount) {
+            curve[size] = rules->steps[size];
+        } else {
+            // keep going up in the same steps the list ended with
+            uint32_t last = stepCount - 1;
+            int64_t top = rules->steps[last];
+            int64_t step = (last > 0) ? top - (int64_t)rules->steps[last-1] : top;
+            int64_t points = top + step * (int64_t)(size - last);
+            
+            // a curve that climbs fast enough tops out rather than wrapping around
+            if(points <= 0) {
+                curve[size] = 0;
+            } else {
+                curve[size] = (points < UINT32_MAX) ? (uint32_t)points : UINT32_MAX;
+            }
+        }
+    }
+    
+    // then scaled for every color - the first color last, as it's the curve we scale from
+    for(int color=SCORING_MAX_COLORS-1; color>=0; color--) {
+        for(int size=0; size<=tables->largestCluster; size++) {
+            uint64_t points = (uint64_t)curve[size] * rules->colorPercent[color] / 100;
+            tables->points[color][size] = (points < UINT32_MAX) ? (uint32_t)points : UINT32_MAX;
+        }
+    }
+}
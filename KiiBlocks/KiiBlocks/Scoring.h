@@ -0,0 +1,141 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#ifndef KiiBlocks_Scoring_h
+#define KiiBlocks_Scoring_h
+
+#include <stdint.h>
+#include "Board.h"
+
+// what a tap is worth. a mode states its scoring as a few short lists (the
+// rules below), which are worked out once per game into lookup tables - so
+// scoring a tap is a couple of table reads, whatever the rules are. plain C,
+// so the validator scores replays with exactly the same code as the game
+
+// the longest lists the rules can have
+#define SCORING_MAX_STEPS       32
+#define SCORING_MAX_COLORS      8
+#define SCORING_MAX_CHAIN       8
+
+// the rules as a mode states them. fixed size and little-endian, so they can
+// travel in a replay record as they are (see Replay.h)
+typedef struct {
+    
+    // the points for busting a cluster of n blocks are steps[n] (n < stepCount).
+    // past the end of the list, each extra block adds as much as the last step
+    // did. with no steps every block is worth a point
+    uint32_t stepCount;
+    uint32_t steps[SCORING_MAX_STEPS];
+    
+    // what a cluster is worth is scaled by its color, in percent
+    uint16_t colorPercent[SCORING_MAX_COLORS];
+    
+    // a clear within chainWindowMillis of the one before carries the chain on.
+    // the n-th clear of a chain (counting from 0) is scaled by chainPercent[n]
+    // - or the last one for longer chains. with no list chains count for nothing
+    uint32_t chainWindowMillis;
+    uint32_t chainCount;
+    uint16_t chainPercent[SCORING_MAX_CHAIN];
+    
+    // extra points for a cluster that was every block of its color on the board.
+    // the board always refills, so this is as close to clearing it as it gets
+    uint32_t colorClearBonus;
+} KBScoringRules;
+
+// the rules worked out for a board: the points for every cluster size in
+// every color, and the chain scaling for every link of a chain. only the
+// cluster sizes the board can have are filled in
+typedef struct {
+    int largestCluster;
+    uint32_t chainWindowMillis;
+    uint32_t colorClearBonus;
+    
+    // chainPercent[n] is the scaling for the n-th clear of a chain, up to the
+    // last one the rules list (longer chains stay there)
+    uint32_t chainLinks;
+    uint32_t chainPercent[SCORING_MAX_CHAIN];
+    
+    // points[color][size]
+    uint32_t points[SCORING_MAX_COLORS][BOARD_MAX_CELLS + 1];
+} KBScoringTables;
+
+// where a game's chain has got to
+typedef struct {
+    uint32_t length;
+    uint32_t lastMillis;
+    int started;
+} KBScoringChain;
+
+// the rules of the original game: a point a block, no chains or bonuses
+void KBScoringRulesDefault(KBScoringRules *rules);
+
+// build the tables for a board of this size (the tables are big - malloc them)
+void KBScoringTablesBuild(KBScoringTables *tables, const KBScoringRules *rules, int columns, int rows);
+
+// start a game's chain from scratch
+static inline void KBScoringChainReset(KBScoringChain *chain)
+{
+    chain->length = 0;
+    chain->lastMillis = 0;
+    chain->started = 0;
+}
+
+// the points for a clear at millis into the game. clears have to be scored in
+// the order they happened (a clear earlier than the last one counts as at the
+// same time), and taps that didn't clear anything never come here
+static inline uint32_t KBScoringTap(const KBScoringTables *tables, KBScoringChain *chain, int clusterSize, int color, int colorCleared, uint32_t millis)
+{
+    if(millis < chain->lastMillis) {
+        millis = chain->lastMillis;
+    }
+    
+    // carry on the chain, or start a new one
+    if(chain->started && millis - chain->lastMillis <= tables->chainWindowMillis) {
+        ++chain->length;
+    } else {
+        chain->length = 0;
+    }
+    chain->started = 1;
+    chain->lastMillis = millis;
+    
+    uint32_t link = (chain->length < tables->chainLinks) ? chain->length : tables->chainLinks - 1;
+    if(clusterSize > tables->largestCluster) {
+        clusterSize = tables->largestCluster;
+    }
+    
+    // boards with more colors than the rules list (only ever in the tools) share the last one's
+    if(color >= SCORING_MAX_COLORS) {
+        color = SCORING_MAX_COLORS - 1;
+    }
+    
+    // tops out at the largest score there is, as the tables do
+    uint64_t points = (uint64_t)tables->points[color][clusterSize] * tables->chainPercent[link] / 100;
+    points += colorCleared ? tables->colorClearBonus : 0;
+    return (points < UINT32_MAX) ? (uint32_t)points : UINT32_MAX;
+}
+
+// a game's running total with the points of one more clear. it tops out
+// too, so the app, its replay and the validator all agree on a game that
+// would have gone past the largest score
+static inline uint32_t KBScoringAdd(uint32_t total, uint32_t points)
+{
+    return (points < UINT32_MAX - total) ? total + points : UINT32_MAX;
+}
+
+#endif
@@ -0,0 +1,51 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import <Foundation/Foundation.h>
+#import "Board.h"
+#import "BoardDiff.h"
+#import "TapQueue.h"
+
+// owns the logical board and plays taps on it on a queue of its own, so
+// finding clusters, letting columns fall and refilling never take time out of
+// a frame. the scene queues taps and, once a frame, picks up the diffs that
+// came of them. every board handed over starts a new generation - taps and
+// diffs of the previous one are thrown away
+@interface Simulation : NSObject
+
+// the generation of the board set up last
+@property (nonatomic, readonly) uint16_t generation;
+
+// play from now on on a copy of this board. returns the new generation
+- (uint16_t) resetWithBoard:(const KBBoard*)board;
+
+// queue taps (in the order they should be played) and get the simulation going
+// on them. returns how many were queued - if the tap queue fills up, the rest
+// are thrown away
+- (int) queueTaps:(const KBQueuedTap*)taps count:(int)count;
+
+// the next diff to apply, or NULL if there are none yet - free() it when done.
+// main thread only
+- (KBBoardDiff*) nextDiff;
+
+// copy the board as the simulation has it now (which may be a few taps ahead
+// of the screen). returns how many taps have changed it so far
+- (uint32_t) copyBoard:(KBBoard*)board;
+
+@end
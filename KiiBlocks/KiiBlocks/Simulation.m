@@ -0,0 +1,129 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#import "Simulation.h"
+
+@interface Simulation() {
+    
+    // only ever touched on the simulation queue
+    dispatch_queue_t _queue;
+    KBBoard *_board;
+    uint16_t _boardGeneration;
+    uint32_t _sequence;
+    
+    // from the scene to the simulation, and back
+    KBTapQueue _taps;
+    KBBoardDiffQueue _diffs;
+}
+
+@end
+
+@implementation Simulation
+
+- (id) init
+{
+    self = [super init];
+    
+    if(self) {
+        // taps should come back within the frame they were resolved in
+        _queue = dispatch_queue_create("com.kii.KiiBlocks.simulation", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0));
+        
+        _board = malloc(sizeof(KBBoard));
+        memset(_board, 0, sizeof(KBBoard));
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    // whatever is still on the queue holds on to us, so by now it's done
+    KBBoardDiff *diff;
+    while((diff = KBBoardDiffQueuePop(&_diffs)) != NULL) {
+        free(diff);
+    }
+    free(_board);
+}
+
+- (uint16_t) resetWithBoard:(const KBBoard*)board
+{
+    uint16_t generation = ++_generation;
+    
+    // waits for the tap being played, if any - taps still queued after it
+    // are of the old generation and get rejected
+    dispatch_sync(_queue, ^{
+        KBBoardCopy(_board, board);
+        _boardGeneration = generation;
+        _sequence = 0;
+    });
+    
+    return generation;
+}
+
+- (int) queueTaps:(const KBQueuedTap*)taps count:(int)count
+{
+    // taps are played in order, so once one doesn't fit neither do the rest
+    int queued = 0;
+    while(queued < count && KBTapQueuePush(&_taps, taps[queued])) {
+        queued++;
+    }
+    
+    [self run];
+    return queued;
+}
+
+// play queued taps for as long as there's room for their diffs
+- (void) run
+{
+    dispatch_async(_queue, ^{
+        KBQueuedTap tap;
+        
+        while(!KBBoardDiffQueueFull(&_diffs) && KBTapQueuePop(&_taps, &tap)) {
+            KBBoardDiffQueuePush(&_diffs, KBBoardDiffForTap(_board, &tap, _boardGeneration, &_sequence));
+        }
+    });
+}
+
+- (KBBoardDiff*) nextDiff
+{
+    KBBoardDiff *diff = KBBoardDiffQueuePop(&_diffs);
+    
+    // the diff queue was full - now there's room, pick up the taps that were waiting
+    if(diff == NULL && _taps.head != __atomic_load_n(&_taps.tail, __ATOMIC_ACQUIRE)) {
+        [self run];
+    }
+    
+    return diff;
+}
+
+- (uint32_t) copyBoard:(KBBoard*)board
+{
+    __block uint32_t sequence;
+    
+    // a tap takes microseconds, so waiting our turn is quick
+    dispatch_sync(_queue, ^{
+        KBBoardCopy(board, _board);
+        sequence = _sequence;
+    });
+    
+    return sequence;
+}
+
+@end
@@ -0,0 +1,85 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#ifndef KiiBlocks_TapEventRing_h
+#define KiiBlocks_TapEventRing_h
+
+#include <stdint.h>
+
+// must be a power of two so the indices can wrap with a mask
+#define TAP_EVENT_RING_SIZE     1024
+
+// a single tap, as recorded on the game thread
+typedef struct {
+    uint16_t clusterSize;
+    uint8_t color;
+    uint8_t removed;            // 1 if the tap actually busted the cluster
+    float secondsSinceStart;
+} KBTapEvent;
+
+// a lock-free single-producer / single-consumer queue of tap events. the
+// game thread pushes, the analytics queue pops - neither ever waits
+typedef struct {
+    KBTapEvent events[TAP_EVENT_RING_SIZE];
+    
+    // the head is only written by the producer and the tail by the consumer,
+    // keep them on separate cache lines so they don't fight over one
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+    
+    // events thrown away because the consumer fell behind
+    uint32_t dropped;
+} KBTapEventRing;
+
+// record an event - returns 0 (and counts a drop) if the ring is full
+static inline int KBTapEventRingPush(KBTapEventRing *ring, KBTapEvent event)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    
+    if(head - tail == TAP_EVENT_RING_SIZE) {
+        ++ring->dropped;
+        return 0;
+    }
+    
+    ring->events[head & (TAP_EVENT_RING_SIZE-1)] = event;
+    
+    // publish the event only once it has been fully written
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// take the oldest event - returns 0 if the ring is empty
+static inline int KBTapEventRingPop(KBTapEventRing *ring, KBTapEvent *event)
+{
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    
+    if(tail == head) {
+        return 0;
+    }
+    
+    *event = ring->events[tail & (TAP_EVENT_RING_SIZE-1)];
+    
+    // hand the slot back to the producer
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+#endif
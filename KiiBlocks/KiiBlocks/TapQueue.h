@@ -0,0 +1,112 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+#ifndef KiiBlocks_TapQueue_h
+#define KiiBlocks_TapQueue_h
+
+#include <stdint.h>
+
+// must be a power of two so the indices can wrap with a mask. a frame never
+// sees more than a handful of taps - this only overflows if nobody is reading
+#define TAP_QUEUE_SIZE  64
+
+// a tap waiting to be resolved against the board
+typedef struct {
+    
+    // when the finger came down, on the KBClockMicros clock
+    uint64_t micros;
+    
+    // how many blocks had dropped into the tapped column by then, as far as
+    // the screen showed. if the column has changed by the time the tap is
+    // resolved, the block under the finger is gone (or has moved) and the tap
+    // is thrown away rather than landing on whatever took its place
+    uint32_t columnStamp;
+    
+    uint8_t column;
+    uint8_t row;
+    
+    // which board the screen was showing - a new game starts a new generation
+    uint16_t generation;
+} KBQueuedTap;
+
+// taps are resolved in the order the fingers came down. fingers that came
+// down together are taken left to right and bottom to top, so the same
+// touches always resolve the same way
+static inline int KBQueuedTapCompare(const void *a, const void *b)
+{
+    const KBQueuedTap *x = a;
+    const KBQueuedTap *y = b;
+    
+    if(x->micros != y->micros) {
+        return (x->micros < y->micros) ? -1 : 1;
+    }
+    if(x->column != y->column) {
+        return (int)x->column - (int)y->column;
+    }
+    return (int)x->row - (int)y->row;
+}
+
+// a lock-free single-producer / single-consumer queue of taps, in the same
+// style as the tap event ring: touch handling pushes, whoever owns the board
+// pops - neither ever waits
+typedef struct {
+    KBQueuedTap taps[TAP_QUEUE_SIZE];
+    
+    // the head is only written by the producer and the tail by the consumer,
+    // keep them on separate cache lines so they don't fight over one
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+} KBTapQueue;
+
+// queue a tap - returns 0 if the queue is full (the caller decides what
+// becomes of the tap)
+static inline int KBTapQueuePush(KBTapQueue *queue, KBQueuedTap tap)
+{
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    
+    if(head - tail == TAP_QUEUE_SIZE) {
+        return 0;
+    }
+    
+    queue->taps[head & (TAP_QUEUE_SIZE-1)] = tap;
+    
+    // publish the tap only once it has been fully written
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// take the oldest tap - returns 0 if the queue is empty
+static inline int KBTapQueuePop(KBTapQueue *queue, KBQueuedTap *tap)
+{
+    uint32_t tail = queue->tail;
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    
+    if(tail == head) {
+        return 0;
+    }
+    
+    *tap = queue->taps[tail & (TAP_QUEUE_SIZE-1)];
+    
+    // hand the slot back to the producer
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+#endif
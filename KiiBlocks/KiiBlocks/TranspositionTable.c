@@ -0,0 +1,102 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#include "TranspositionTable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the data word: the value in the low 32 bits, the depth above it
+#define ENTRY_DEPTH_SHIFT   32
+
+// a value is only good for the depth it was worked out at (the most the next
+// n taps can remove says little about n-1 or n+1), so every depth of a
+// position gets a key - and a slot - of its own
+static inline uint64_t KBTranspositionKey(uint64_t key, int depth)
+{
+    return key ^ ((uint64_t)(depth + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+KBTranspositionTable *KBTranspositionTableCreate(int bits)
+{
+    KBTranspositionTable *table = malloc(sizeof(KBTranspositionTable));
+    if(table == NULL) {
+        return NULL;
+    }
+    
+    table->mask = (1ULL << bits) - 1;
+    table->entries = calloc(table->mask + 1, sizeof(KBTranspositionEntry));
+    
+    if(table->entries == NULL) {
+        free(table);
+        return NULL;
+    }
+    
+    return table;
+}
+
+void KBTranspositionTableDestroy(KBTranspositionTable *table)
+{
+    if(table != NULL) {
+        free(table->entries);
+        free(table);
+    }
+}
+
+void KBTranspositionTableClear(KBTranspositionTable *table)
+{
+    memset(table->entries, 0, (table->mask + 1) * sizeof(KBTranspositionEntry));
+}
+
+uint64_t KBTranspositionTableBytes(const KBTranspositionTable *table)
+{
+    return (table->mask + 1) * sizeof(KBTranspositionEntry);
+}
+
+int KBTranspositionTableProbe(KBTranspositionTable *table, uint64_t key, int depth, uint32_t *value)
+{
+    key = KBTranspositionKey(key, depth);
+    KBTranspositionEntry *entry = &table->entries[key & table->mask];
+    
+    uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+    uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    
+    // an empty slot, someone else's key, or a half-written entry
+    if((check ^ data) != key || data == 0) {
+        return 0;
+    }
+    
+    if((int)(data >> ENTRY_DEPTH_SHIFT) != depth) {
+        return 0;
+    }
+    
+    *value = (uint32_t)data;
+    return 1;
+}
+
+void KBTranspositionTableStore(KBTranspositionTable *table, uint64_t key, int depth, uint32_t value)
+{
+    key = KBTranspositionKey(key, depth);
+    KBTranspositionEntry *entry = &table->entries[key & table->mask];
+    uint64_t data = ((uint64_t)depth << ENTRY_DEPTH_SHIFT) | value;
+    
+    __atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,62 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+
+#ifndef KiiBlocks_TranspositionTable_h
+#define KiiBlocks_TranspositionTable_h
+
+#include <stdint.h>
+
+// remembers what searches have worked out about board positions (keyed by
+// the board's zobrist hash), so a position reached again - by another path,
+// another hint request or another thread - isn't evaluated twice.
+//
+// the table has a fixed size and never locks: an entry is two 64-bit words,
+// the key xor'ed with the data and the data itself. a reader recomputes the
+// key from both, so an entry torn by two threads writing at once simply
+// doesn't match and is treated as missing
+
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} KBTranspositionEntry;
+
+typedef struct {
+    uint64_t mask;
+    KBTranspositionEntry *entries;
+} KBTranspositionTable;
+
+// a table with 2^bits entries (16 bytes each). returns NULL if out of memory
+KBTranspositionTable *KBTranspositionTableCreate(int bits);
+void KBTranspositionTableDestroy(KBTranspositionTable *table);
+
+// forget everything
+void KBTranspositionTableClear(KBTranspositionTable *table);
+
+// the size of the table in bytes
+uint64_t KBTranspositionTableBytes(const KBTranspositionTable *table);
+
+// look up a value stored for a key at exactly the given search depth
+int KBTranspositionTableProbe(KBTranspositionTable *table, uint64_t key, int depth, uint32_t *value);
+
+// store a value for a key at a search depth. every depth of a key is kept
+// apart; whatever is stored last takes the slot over
+void KBTranspositionTableStore(KBTranspositionTable *table, uint64_t key, int depth, uint32_t value);
+
+#endif
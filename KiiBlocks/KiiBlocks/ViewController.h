@@ -22,4 +22,9 @@
 
 @interface ViewController : UIViewController
 
+// pause the game and keep a snapshot of it on disk, in case we're not
+// brought back (called as the app resigns active). the next launch picks
+// the game up from there
+- (void) saveGame;
+
 @end
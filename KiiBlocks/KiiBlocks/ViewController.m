@@ -19,21 +19,25 @@
 
 #import "ViewController.h"
 #import "MyScene.h"
+#import "Instrumentation.h"
+#import "Clock.h"
+#import "MemoryBudget.h"
+
+@interface ViewController() {
+    InstrumentationOverlay *_overlay;
+}
+
+@end
 
 @implementation ViewController
 
-// when the view controller appears (on launch)
+// when the view controller appears - on launch, and again when a view we presented goes away
 - (void) viewDidAppear:(BOOL)animated
 {
-    
-    // we check to see if there is a user logged in
-    if(![KiiUser loggedIn]) {
-        
-        // if not, show a login view
-        KTLoginViewController *lvc = [[KTLoginViewController alloc] init];
-        [self presentViewController:lvc animated:TRUE completion:nil];
-        
-    }
+    // nobody has to log in to play - only to keep a score. if the login view
+    // was shown for a finished game, that score can go up now
+    MyScene *scene = (MyScene*)((SKView*)self.view).scene;
+    [scene resumeScoreSubmission];
 }
 
 - (void)viewDidLoad
@@ -42,16 +46,88 @@
 
     // Configure the view.
     SKView * skView = (SKView *)self.view;
-//    skView.showsFPS = YES;
-//    skView.showsNodeCount = YES;
+    
+    // every finger counts - fast players tap with more than one
+    skView.multipleTouchEnabled = TRUE;
+    
+#ifdef DEBUG
+    skView.showsFPS = YES;
+    skView.showsNodeCount = YES;
+    
+    // a two finger tap shows the instrumentation overlay, a three finger tap exports it
+    UITapGestureRecognizer *overlayTap = [[UITapGestureRecognizer alloc] initWithTarget:self action:@selector(toggleOverlay:)];
+    overlayTap.numberOfTouchesRequired = 2;
+    overlayTap.cancelsTouchesInView = FALSE;
+    [skView addGestureRecognizer:overlayTap];
+    
+    UITapGestureRecognizer *exportTap = [[UITapGestureRecognizer alloc] initWithTarget:self action:@selector(exportInstrumentation:)];
+    exportTap.numberOfTouchesRequired = 3;
+    exportTap.cancelsTouchesInView = FALSE;
+    [skView addGestureRecognizer:exportTap];
+#endif
     
     // Create and configure the scene.
     MyScene * scene = [MyScene sceneWithSize:skView.bounds.size];
     scene.scaleMode = SKSceneScaleModeAspectFill;
     scene.parentViewController = self; // make this view controller accessible to our scene
     
+    // carry on with the game we were playing when we were last sent away, if any
+    NSData *snapshot = [NSData dataWithContentsOfFile:[self snapshotPath]];
+    if(snapshot != nil && ![scene restoreSnapshot:snapshot]) {
+        [[NSFileManager defaultManager] removeItemAtPath:[self snapshotPath] error:nil];
+    }
+    
     // Present the scene.
     [skView presentScene:scene];
+    [[Instrumentation sharedInstrumentation] markStartupPhase:@"scenePresented"];
+}
+
+// where the game in progress is kept while we're in the background
+- (NSString*) snapshotPath
+{
+    NSString *documents = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, TRUE) lastObject];
+    return [documents stringByAppendingPathComponent:@"snapshot.bin"];
+}
+
+- (void) saveGame
+{
+    MyScene *scene = (MyScene*)((SKView*)self.view).scene;
+    
+    uint64_t started = KBClockMicros();
+    [scene pauseGame];
+    NSData *snapshot = [scene snapshot];
+    
+    // no game going on - make sure an old one doesn't come back
+    if(snapshot == nil) {
+        [[NSFileManager defaultManager] removeItemAtPath:[self snapshotPath] error:nil];
+        return;
+    }
+    
+    [snapshot writeToFile:[self snapshotPath] atomically:TRUE];
+    [[Instrumentation sharedInstrumentation] recordSaveGameMicros:KBClockMicros() - started];
+}
+
+// show or hide the performance overlay
+- (void) toggleOverlay:(UITapGestureRecognizer*)recognizer
+{
+    if(_overlay.superview != nil) {
+        [_overlay removeFromSuperview];
+        return;
+    }
+    
+    if(_overlay == nil) {
+        _overlay = [[InstrumentationOverlay alloc] initWithFrame:CGRectMake(0, 20, self.view.bounds.size.width, 84)];
+    }
+    
+    [self.view addSubview:_overlay];
+    [_overlay startUpdating];
+}
+
+// write the performance report to Documents/instrumentation.json
+- (void) exportInstrumentation:(UITapGestureRecognizer*)recognizer
+{
+    NSString *path = [[Instrumentation sharedInstrumentation] exportJSON];
+    NSLog(@"Instrumentation exported to %@", path);
 }
 
 - (BOOL)shouldAutorotate
@@ -72,6 +148,9 @@
 {
     [super didReceiveMemoryWarning];
     // Release any cached data, images, etc that aren't in use.
+    
+    // every cache has registered with the budget - it decides what goes
+    [[MemoryBudget sharedBudget] didReceiveMemoryWarning];
 }
 
 @end
@@ -0,0 +1,746 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+// Server code for KiiBlocks. Deploy it together with hooks.json so the
+// endpoints below run whenever a score is saved to the 'scores' bucket.
+//
+
+// the number of entries kept in the live leaderboard (matches LEADERBOARD_SIZE)
+var LEADERBOARD_SIZE = 20;
+
+// how many times we retry when another submission updated the board first
+var MAX_RETRIES = 5;
+
+// how many geohash characters make up a regional leaderboard cell. 4
+// characters is roughly 40km x 20km (matches GEOCELL_PRECISION on the client)
+var GEOCELL_PRECISION = 4;
+
+var GEOHASH_ALPHABET = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+// daily and weekly leaderboards are kept per window, keyed by the window's
+// first day (UTC) - 'day:2013-11-04' and 'week:2013-11-04' (weeks start on
+// Monday). a new window simply starts a new object, so nothing has to be
+// reset at midnight and reading a window is always a single object
+var DAY_MILLIS = 24 * 60 * 60 * 1000;
+
+// the score sketch behind 'top x%' ranks - a count of scores per logarithmic
+// bucket, laid out exactly like KBScoreSketch on the client (ScoreSketch.h):
+// bucket i holds the scores in (gamma^(i-1), gamma^i]
+var SKETCH_ACCURACY = 0.01;
+var SKETCH_GAMMA = (1 + SKETCH_ACCURACY) / (1 - SKETCH_ACCURACY);
+var SKETCH_BUCKETS = 1024;
+
+// every submission updates a single object, so the sketch is spread over a
+// few shards to keep submissions from fighting over it. sketches merge by
+// adding up their buckets, so clients read all of them and add them up
+var SKETCH_SHARDS = 8;
+
+// compactScores folds scores older than this into the archive
+var ARCHIVE_AFTER_DAYS = 30;
+
+// how many scores compactScores reads, folds and deletes at a time
+var COMPACTION_BATCH = 200;
+
+// compactScores doesn't start another batch after running this long - the
+// next run carries on from where it stopped
+var COMPACTION_BUDGET_MILLIS = 15000;
+
+// the geohash of the cell containing a point. we work out the integer
+// longitude/latitude cell indices first and interleave their bits, which
+// gives the same string as the classic bisection algorithm
+function geocellFor(latitude, longitude, precision) {
+    var bits = precision * 5;
+    var lonBits = Math.ceil(bits / 2);
+    var latBits = Math.floor(bits / 2);
+
+    var x = Math.floor((longitude + 180) / 360 * Math.pow(2, lonBits));
+    var y = Math.floor((latitude + 90) / 180 * Math.pow(2, latBits));
+    x = Math.min(Math.max(x, 0), Math.pow(2, lonBits) - 1);
+    y = Math.min(Math.max(y, 0), Math.pow(2, latBits) - 1);
+
+    var hash = "";
+    var value = 0;
+    var xBit = lonBits - 1, yBit = latBits - 1;
+
+    for (var i = 0; i < bits; i++) {
+        // even bits come from the longitude, odd bits from the latitude
+        var bit = (i % 2 === 0) ? (Math.floor(x / Math.pow(2, xBit--)) % 2)
+                                : (Math.floor(y / Math.pow(2, yBit--)) % 2);
+        value = value * 2 + bit;
+
+        if (i % 5 === 4) {
+            hash += GEOHASH_ALPHABET.charAt(value);
+            value = 0;
+        }
+    }
+
+    return hash;
+}
+
+// whether a client sent us a geo cell of the precision the regional boards
+// use. anything else would open a board nobody can look up
+function isGeocell(value) {
+    if (typeof value !== "string" || value.length !== GEOCELL_PRECISION) {
+        return false;
+    }
+    for (var i = 0; i < value.length; i++) {
+        if (GEOHASH_ALPHABET.indexOf(value.charAt(i)) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// find where a score belongs in a best-first list of {s, u} entries.
+// returns -1 if it doesn't make the cut
+function rankForScore(entries, score, size) {
+    for (var i = 0; i < entries.length; i++) {
+        if (score > entries[i].s) {
+            return i;
+        }
+    }
+    return (entries.length < size) ? entries.length : -1;
+}
+
+// the day (as yyyy-mm-dd, UTC) of a time in milliseconds
+function dayString(millis) {
+    var date = new Date(millis);
+    var month = date.getUTCMonth() + 1;
+    var day = date.getUTCDate();
+    return date.getUTCFullYear() + "-" + (month < 10 ? "0" : "") + month + "-" + (day < 10 ? "0" : "") + day;
+}
+
+// the keys of the daily and weekly leaderboards a score made at this time
+// goes on (the same sums as LeaderboardCache on the client)
+function windowBoardsFor(millis) {
+    var day = Math.floor(millis / DAY_MILLIS);
+
+    // the epoch was a Thursday, so Monday is 3 days further into the week
+    var monday = day - ((day + 3) % 7);
+
+    return ["day:" + dayString(day * DAY_MILLIS), "week:" + dayString(monday * DAY_MILLIS)];
+}
+
+// the bucket a score of at least 1 goes in (the same sum as KBScoreSketchIndex)
+function sketchIndex(score) {
+    var index = Math.ceil(Math.log(score) / Math.log(SKETCH_GAMMA));
+    return Math.min(Math.max(index, 0), SKETCH_BUCKETS - 1);
+}
+
+// a copy of a default field value, so new objects never share an array
+function copyOf(value) {
+    return (typeof value === "object" && value !== null) ? JSON.parse(JSON.stringify(value)) : value;
+}
+
+// the ID of the object keyed by 'key' in its bucket. object IDs may only hold
+// letters, digits, '-', '_' and '.', so '_' and anything else is escaped as
+// '_' and its hex code ('day:2013-11-04' is 'day_3a2013-11-04')
+function objectIDFor(key) {
+    return String(key).replace(/[^A-Za-z0-9.\-]/g, function(c) {
+        var code = c.charCodeAt(0).toString(16);
+        return "_" + (code.length < 2 ? "0" : "") + code;
+    });
+}
+
+// fetch the single object keyed by 'board' in a bucket, or a new one with the
+// given fields if there isn't one yet. a new object gets the ID derived from
+// the key, so when two submissions create the same board at once only the
+// first save without overwrite succeeds and the other retries on the stored
+// one, rather than both saving a copy of their own
+function loadObject(bucket, board, fields, callbacks) {
+    var query = KiiQuery.queryWithClause(KiiClause.equals("board", board));
+    query.setLimit(1);
+
+    bucket.executeQuery(query, {
+        success: function(queryPerformed, resultSet, nextQuery) {
+            if (resultSet.length > 0) {
+                callbacks.success(resultSet[0]);
+            } else {
+                var object = bucket.createObjectWithID(objectIDFor(board));
+                object.set("board", board);
+                for (var key in fields) {
+                    object.set(key, copyOf(fields[key]));
+                }
+                callbacks.success(object);
+            }
+        },
+        failure: function(queryPerformed, errorString) {
+            callbacks.failure(errorString);
+        }
+    });
+}
+
+// fetch the objects whose 'key' field holds each of the given values, with
+// new ones (holding the given fields, and IDs derived from the values like
+// loadObject) for any that don't exist yet. succeeds with an object of
+// objects keyed by value
+function loadObjects(bucket, key, values, fields, callbacks) {
+    var query = KiiQuery.queryWithClause(KiiClause.inClause(key, values));
+    query.setLimit(values.length);
+
+    bucket.executeQuery(query, {
+        success: function(queryPerformed, resultSet, nextQuery) {
+            var objects = {};
+            for (var i = 0; i < resultSet.length; i++) {
+                objects[resultSet[i].get(key)] = resultSet[i];
+            }
+
+            for (var j = 0; j < values.length; j++) {
+                if (!objects[values[j]]) {
+                    var object = bucket.createObjectWithID(objectIDFor(values[j]));
+                    object.set(key, values[j]);
+                    for (var field in fields) {
+                        object.set(field, copyOf(fields[field]));
+                    }
+                    objects[values[j]] = object;
+                }
+            }
+
+            callbacks.success(objects);
+        },
+        failure: function(queryPerformed, errorString) {
+            callbacks.failure(errorString);
+        }
+    });
+}
+
+// save or delete a list of objects one after another, stopping at the first error
+function saveEach(objects, done) {
+    if (objects.length === 0) {
+        done(null);
+        return;
+    }
+    objects[0].save({
+        success: function() { saveEach(objects.slice(1), done); },
+        failure: function(object, errorString) { done(errorString); }
+    });
+}
+
+function deleteEach(objects, done) {
+    if (objects.length === 0) {
+        done(null);
+        return;
+    }
+    objects[0]["delete"]({
+        success: function() { deleteEach(objects.slice(1), done); },
+        failure: function(object, errorString) { done(errorString); }
+    });
+}
+
+// fetch the single object holding a leaderboard, creating it if needed
+function loadBoard(bucket, board, callbacks) {
+    loadObject(bucket, board, { seq: 0, entries: [] }, callbacks);
+}
+
+// insert a score into a leaderboard object held in the given bucket. if a
+// topic is given and the score made the list, a compact delta is published
+// on it so clients can patch their cached copy instead of querying again
+function updateBoard(bucket, board, topic, score, username, attempt, done) {
+    loadBoard(bucket, board, {
+        success: function(object) {
+            var entries = object.get("entries") || [];
+            var rank = rankForScore(entries, score, LEADERBOARD_SIZE);
+
+            // didn't make the leaderboard - nothing changes, nothing is sent
+            if (rank < 0) {
+                done(null);
+                return;
+            }
+
+            entries.splice(rank, 0, { s: score, u: username });
+            if (entries.length > LEADERBOARD_SIZE) {
+                entries.pop();
+            }
+
+            var seq = (object.get("seq") || 0) + 1;
+            object.set("entries", entries);
+            object.set("seq", seq);
+
+            // save without overwriting - if someone else changed the board since we
+            // read it the save fails and we start over, so sequence numbers never repeat
+            object.saveAllFields({
+                success: function(savedObject) {
+                    if (topic === null) {
+                        done(null);
+                        return;
+                    }
+
+                    var message = new KiiPushMessageBuilder({
+                        t: "lb", b: board, q: seq, r: rank, s: score, u: username
+                    }).build();
+
+                    topic.sendMessage(message, {
+                        success: function() {
+                            done(null);
+                        },
+                        failure: function(topic, errorString) {
+                            // clients recover from a missing delta by re-seeding
+                            done(errorString);
+                        }
+                    });
+                },
+                failure: function(savedObject, errorString) {
+                    if (attempt < MAX_RETRIES) {
+                        updateBoard(bucket, board, topic, score, username, attempt + 1, done);
+                    } else {
+                        done(errorString);
+                    }
+                }
+            }, false);
+        },
+        failure: function(errorString) {
+            done(errorString);
+        }
+    });
+}
+
+// count a score in an object holding a sketch. only the span of buckets in
+// use is stored: 'o' is the index of the first one and 'c' their counts, 'z'
+// the scores below 1 and 'n' all of them
+function addToSketch(object, score) {
+    var counts = object.get("c") || [];
+    var offset = object.get("o") || 0;
+
+    if (score < 1) {
+        object.set("z", (object.get("z") || 0) + 1);
+    } else {
+        var index = sketchIndex(score);
+
+        // grow the stored span to take in the new bucket
+        if (counts.length === 0) {
+            offset = index;
+        }
+        while (index < offset) {
+            counts.unshift(0);
+            offset--;
+        }
+        while (index >= offset + counts.length) {
+            counts.push(0);
+        }
+
+        counts[index - offset]++;
+        object.set("o", offset);
+        object.set("c", counts);
+    }
+    object.set("n", (object.get("n") || 0) + 1);
+}
+
+// count a score in one shard of the score sketch
+function updateSketch(bucket, score, attempt, done) {
+    var board = "sketch:" + Math.floor(Math.random() * SKETCH_SHARDS);
+
+    loadObject(bucket, board, { n: 0, z: 0, o: 0, c: [] }, {
+        success: function(object) {
+            addToSketch(object, score);
+
+            // the same lost-update protection as the leaderboards
+            object.saveAllFields({
+                success: function(savedObject) {
+                    done(null);
+                },
+                failure: function(savedObject, errorString) {
+                    if (attempt < MAX_RETRIES) {
+                        updateSketch(bucket, score, attempt + 1, done);
+                    } else {
+                        done(errorString);
+                    }
+                }
+            }, false);
+        },
+        failure: function(errorString) {
+            done(errorString);
+        }
+    });
+}
+
+// put a score on several leaderboards in the same bucket, one after another
+function updateBoards(bucket, boards, score, username, done) {
+    if (boards.length === 0) {
+        done(null);
+        return;
+    }
+
+    updateBoard(bucket, boards[0], null, score, username, 0, function(error) {
+        updateBoards(bucket, boards.slice(1), score, username, function(laterError) {
+            done(error || laterError);
+        });
+    });
+}
+
+// fan a score in to the leaderboard of every group the player belongs to, so
+// reading a friends leaderboard is a single object read instead of an 'in'
+// query over every member's username
+function updateGroupBoards(admin, userID, score, username, done) {
+    if (!userID) {
+        done(null);
+        return;
+    }
+
+    admin.userWithID(userID).memberOfGroups({
+        success: function(theUser, groupList) {
+            var pending = groupList.length;
+            var firstError = null;
+
+            if (pending === 0) {
+                done(null);
+                return;
+            }
+
+            for (var i = 0; i < groupList.length; i++) {
+                var bucket = admin.groupWithURI(groupList[i].objectURI()).bucketWithName("leaderboard");
+
+                updateBoard(bucket, "group", null, score, username, 0, function(error) {
+                    firstError = firstError || error;
+                    if (--pending === 0) {
+                        done(firstError);
+                    }
+                });
+            }
+        },
+        failure: function(theUser, errorString) {
+            done(errorString);
+        }
+    });
+}
+
+// the app sends a score again when it didn't hear back from the first save,
+// which may well have made it. every copy carries the client id the app gave
+// the score, and only the first copy saved (the oldest, then the lowest id)
+// is kept. succeeds with true if the given one is a copy to drop
+function isResentScore(bucket, object, callbacks) {
+    var clientID = object.get("clientID");
+    if (!clientID) {
+        callbacks.success(false);
+        return;
+    }
+
+    var query = KiiQuery.queryWithClause(KiiClause.equals("clientID", clientID));
+
+    bucket.executeQuery(query, {
+        success: function(queryPerformed, resultSet, nextQuery) {
+            var first = object;
+            for (var i = 0; i < resultSet.length; i++) {
+                var copy = resultSet[i];
+                if (copy.getCreated() < first.getCreated() ||
+                    (copy.getCreated() === first.getCreated() && copy.getUUID() < first.getUUID())) {
+                    first = copy;
+                }
+            }
+            callbacks.success(first.getUUID() !== object.getUUID());
+        },
+        failure: function(queryPerformed, errorString) {
+            callbacks.failure(errorString);
+        }
+    });
+}
+
+// put a new score on every leaderboard it belongs on, and count it in the sketch
+function postScore(admin, object, done) {
+    var score = object.get("score");
+    var username = object.get("username");
+
+    // the player is whoever saved the score - a field the app writes could
+    // name anybody, and put scores on the boards of groups they aren't in
+    var owner = object.getOwner();
+    var userID = owner ? owner.getID() : null;
+
+    var global = admin.bucketWithName("leaderboard");
+    var topic = admin.topicWithName("leaderboard");
+
+    // the daily and weekly boards of when the score was made
+    var boards = windowBoardsFor(object.getCreated());
+
+    // scores tagged with the geo cell they were played in also go on that
+    // cell's board, so 'top near me' is an equality lookup rather than a radius scan
+    var geocell = object.get("geocell");
+    if (isGeocell(geocell)) {
+        boards.push("geo:" + geocell);
+    }
+
+    updateBoard(global, "global", topic, score, username, 0, function(globalError) {
+        updateGroupBoards(admin, userID, score, username, function(groupError) {
+
+            updateBoards(global, boards, score, username, function(boardsError) {
+                updateSketch(global, score, 0, function(sketchError) {
+                    var error = globalError || groupError || boardsError || sketchError;
+                    done(error ? { error: error } : { result: "ok" });
+                });
+            });
+        });
+    });
+}
+
+// hook: called after every object created in the 'scores' bucket
+function onScoreCreated(params, context, done) {
+    var admin = context.getAppAdminContext();
+    var scoreObject = admin.objectWithURI(params.uri);
+
+    scoreObject.refresh({
+        success: function(object) {
+            isResentScore(admin.bucketWithName("scores"), object, {
+                success: function(resent) {
+                    if (!resent) {
+                        postScore(admin, object, done);
+                        return;
+                    }
+
+                    // the first copy is already on the leaderboards - this one just goes
+                    object["delete"]({
+                        success: function() { done({ result: "duplicate" }); },
+                        failure: function(theObject, errorString) { done({ error: errorString }); }
+                    });
+                },
+                failure: function(errorString) {
+                    done({ error: errorString });
+                }
+            });
+        },
+        failure: function(object, errorString) {
+            done({ error: errorString });
+        }
+    });
+}
+
+// fold a batch of scores into the archive: each player's best score and
+// number of games in the 'bests' bucket, and a sketch of each day's scores
+// (the same layout as the global one) in the 'archive' bucket.
+//
+// every object changed is stamped with the batch's marker, and objects that
+// already carry it are left alone - so folding the same batch again after a
+// run died partway through saving it doesn't count anything twice
+function foldScores(admin, scores, marker, done) {
+    var bests = {};
+    var days = {};
+
+    for (var i = 0; i < scores.length; i++) {
+        var score = scores[i].get("score") || 0;
+        var owner = scores[i].getOwner();
+        var user = (owner ? owner.getID() : null) || scores[i].get("username") || "";
+        var day = "hist:" + dayString(scores[i].getCreated());
+
+        var best = bests[user] || (bests[user] = { username: scores[i].get("username"), best: 0, games: 0 });
+        best.best = Math.max(best.best, score);
+        best.games++;
+
+        (days[day] || (days[day] = [])).push(score);
+    }
+
+    var failure = function(errorString) { done(errorString); };
+
+    loadObjects(admin.bucketWithName("bests"), "user", Object.keys(bests), { best: 0, games: 0 }, {
+        success: function(bestObjects) {
+            loadObjects(admin.bucketWithName("archive"), "board", Object.keys(days), { n: 0, z: 0, o: 0, c: [] }, {
+                success: function(dayObjects) {
+                    var changed = [];
+
+                    for (var user in bests) {
+                        var object = bestObjects[user];
+                        if (object.get("folded") === marker) {
+                            continue;
+                        }
+                        object.set("username", bests[user].username);
+                        object.set("best", Math.max(object.get("best"), bests[user].best));
+                        object.set("games", object.get("games") + bests[user].games);
+                        object.set("folded", marker);
+                        changed.push(object);
+                    }
+
+                    for (var day in days) {
+                        if (dayObjects[day].get("folded") === marker) {
+                            continue;
+                        }
+                        for (var j = 0; j < days[day].length; j++) {
+                            addToSketch(dayObjects[day], days[day][j]);
+                        }
+                        dayObjects[day].set("folded", marker);
+                        changed.push(dayObjects[day]);
+                    }
+
+                    saveEach(changed, done);
+                },
+                failure: failure
+            });
+        },
+        failure: failure
+    });
+}
+
+// endpoint (run daily by the scheduler in hooks.json): fold scores older than
+// ARCHIVE_AFTER_DAYS into the archive and delete them, oldest first, a batch
+// at a time. the 'scores' bucket then only ever holds the recent games, which
+// keeps every query on it fast.
+//
+// a run can stop anywhere (the time budget, an error, a timeout) without a
+// score being counted twice or lost. before a batch is folded, the scores in
+// it are noted down as pending, under a marker (the id of its last score);
+// a run that finds a pending batch folds exactly those scores again, and the
+// marker on every object already folded keeps it from counting them twice.
+// once the fold is saved we note how far we got, and only then delete - so
+// scores from before that point are only deleted, never folded again.
+// params.now overrides the current time, and params.maxBatches stops the
+// run after that many batches
+function compactScores(params, context, done) {
+    var admin = context.getAppAdminContext();
+    var scores = admin.bucketWithName("scores");
+    var archive = admin.bucketWithName("archive");
+
+    var started = Date.now();
+    var now = (params && params.now) || started;
+    var cutoff = now - ARCHIVE_AFTER_DAYS * DAY_MILLIS;
+    var stats = { folded: 0, deleted: 0, batches: 0, finished: false };
+
+    var finish = function(errorString) {
+        done(errorString ? { error: errorString, result: stats } : { result: stats });
+    };
+
+    var maxBatches = (params && params.maxBatches) || Infinity;
+
+    var nextBatch = function() {
+        if (Date.now() - started > COMPACTION_BUDGET_MILLIS || stats.batches >= maxBatches) {
+            finish(null);
+            return;
+        }
+
+        var query = KiiQuery.queryWithClause(KiiClause.lessThan("_created", cutoff));
+        query.sortByAsc("_created");
+        query.setLimit(COMPACTION_BATCH);
+
+        scores.executeQuery(query, {
+            success: function(queryPerformed, batch, nextQuery) {
+                if (batch.length === 0) {
+                    stats.finished = true;
+                    finish(null);
+                    return;
+                }
+
+                // 'through' is the creation time of the last score folded, and
+                // 'atThrough' the ids of the scores folded at or after that time.
+                // 'pending' holds the ids of a batch that is being folded, and
+                // 'marker' the marker it is folded under
+                loadObject(archive, "state:compaction", { through: 0, atThrough: [], pending: [], marker: "" }, {
+                    success: function(state) {
+                        var through = state.get("through");
+                        var atThrough = state.get("atThrough");
+                        var pending = state.get("pending") || [];
+
+                        var fresh = batch.filter(function(object) {
+                            var created = object.getCreated();
+                            return pending.length > 0 ? pending.indexOf(object.getUUID()) >= 0
+                                                      : created >= through && atThrough.indexOf(object.getUUID()) < 0;
+                        });
+
+                        var fold = function(marker) {
+                            foldScores(admin, fresh, marker, function(foldError) {
+                                if (foldError) {
+                                    finish(foldError);
+                                    return;
+                                }
+                                checkpoint(state, fresh, pending);
+                            });
+                        };
+
+                        // a batch left pending by a run that stopped is folded again under
+                        // its old marker - anything else is noted down as pending first
+                        if (pending.length > 0) {
+                            fold(state.get("marker"));
+                            return;
+                        }
+
+                        var marker = (fresh.length > 0) ? fresh[fresh.length - 1].getUUID() : "";
+                        state.set("pending", fresh.map(function(object) { return object.getUUID(); }));
+                        state.set("marker", marker);
+                        pending = state.get("pending");
+
+                        state.saveAllFields({
+                            success: function() { fold(marker); },
+                            failure: function(object, errorString) { finish(errorString); }
+                        }, false);
+                    },
+                    failure: finish
+                });
+
+                // note how far we got, then delete the batch
+                function checkpoint(state, fresh, pending) {
+
+                    // the batch is sorted, so the last score is where we got to. a
+                    // pending score that didn't come back in this batch (tied for
+                    // time with the next ones) is noted too, so it's never folded again
+                    var through = state.get("through");
+                    var last = batch[batch.length - 1].getCreated();
+                    var ids = (last === through) ? state.get("atThrough").slice() : [];
+
+                    for (var i = 0; i < batch.length; i++) {
+                        if (batch[i].getCreated() === last && ids.indexOf(batch[i].getUUID()) < 0) {
+                            ids.push(batch[i].getUUID());
+                        }
+                    }
+                    for (var j = 0; j < pending.length; j++) {
+                        var inBatch = batch.some(function(object) { return object.getUUID() === pending[j]; });
+                        if (!inBatch && ids.indexOf(pending[j]) < 0) {
+                            ids.push(pending[j]);
+                        }
+                    }
+
+                    state.set("through", last);
+                    state.set("atThrough", ids);
+                    state.set("pending", []);
+                    state.set("marker", "");
+
+                    state.saveAllFields({
+                        success: function() {
+                            stats.folded += fresh.length;
+
+                            deleteEach(batch, function(deleteError) {
+                                if (deleteError) {
+                                    finish(deleteError);
+                                    return;
+                                }
+                                stats.deleted += batch.length;
+                                stats.batches++;
+                                nextBatch();
+                            });
+                        },
+                        failure: function(object, errorString) {
+                            finish(errorString);
+                        }
+                    }, false);
+                }
+            },
+            failure: function(queryPerformed, errorString) {
+                finish(errorString);
+            }
+        });
+    };
+
+    nextBatch();
+}
+
+// let the local tools in ServerCode/tools load this file under node
+if (typeof module !== "undefined") {
+    module.exports = {
+        geocellFor: geocellFor,
+        isGeocell: isGeocell,
+        rankForScore: rankForScore,
+        sketchIndex: sketchIndex,
+        windowBoardsFor: windowBoardsFor,
+        SKETCH_SHARDS: SKETCH_SHARDS,
+        onScoreCreated: onScoreCreated,
+        compactScores: compactScores,
+        ARCHIVE_AFTER_DAYS: ARCHIVE_AFTER_DAYS
+    };
+}
@@ -0,0 +1,151 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+// Compares ways of answering 'top scores near me' against the local
+// stand-in, using synthetic geo-tagged scores:
+//
+//   radius scan     - geoDistance clause over the whole 'scores' bucket
+//   geocell lookup  - 'in' clause on the indexed geocell of the 3x3 cells around the player
+//   regional boards - the per-cell leaderboard objects kept by onScoreCreated
+//
+// usage: node bench-geo.js [scoreCount] [queryCount]
+//
+
+var standin = require("./standin.js");
+var server = require("../kiiblocks.js");
+
+var SCORE_COUNT = parseInt(process.argv[2] || "1000000", 10);
+var QUERY_COUNT = parseInt(process.argv[3] || "200", 10);
+var PRECISION = 4;
+var RADIUS = 30000;
+var TOP = 20;
+
+// a small deterministic generator so every run sees the same data
+var seed = 42;
+function random() {
+    seed = (seed * 1103515245 + 12345) % 2147483648;
+    return seed / 2147483648;
+}
+function gaussian() {
+    return Math.sqrt(-2 * Math.log(random() + 1e-12)) * Math.cos(2 * Math.PI * random());
+}
+
+// players mostly live around cities, with some spread everywhere else
+var cities = [];
+for (var i = 0; i < 50; i++) {
+    cities.push({ latitude: random() * 120 - 60, longitude: random() * 360 - 180 });
+}
+function randomLocation() {
+    if (random() < 0.8) {
+        var city = cities[Math.floor(random() * cities.length)];
+        return new standin.KiiGeoPoint(Math.max(-89.9, Math.min(89.9, city.latitude + gaussian() * 0.3)),
+                                       ((city.longitude + gaussian() * 0.3 + 540) % 360) - 180);
+    }
+    return new standin.KiiGeoPoint(random() * 140 - 70, random() * 360 - 180);
+}
+
+// the cell around a point and its eight neighbours
+function cellsAround(location) {
+    var bits = PRECISION * 5;
+    var latStep = 180 / Math.pow(2, Math.floor(bits / 2));
+    var lonStep = 360 / Math.pow(2, Math.ceil(bits / 2));
+    var cells = [];
+
+    for (var dy = -1; dy <= 1; dy++) {
+        for (var dx = -1; dx <= 1; dx++) {
+            var latitude = Math.max(-90, Math.min(89.999999, location.latitude + dy * latStep));
+            var longitude = ((location.longitude + dx * lonStep + 540) % 360) - 180;
+            var cell = server.geocellFor(latitude, longitude, PRECISION);
+            if (cells.indexOf(cell) < 0) cells.push(cell);
+        }
+    }
+    return cells;
+}
+
+function time(label, count, fn) {
+    var start = process.hrtime();
+    var found = 0;
+    for (var i = 0; i < count; i++) {
+        found += fn(i);
+    }
+    var elapsed = process.hrtime(start);
+    var ms = (elapsed[0] * 1e3 + elapsed[1] / 1e6) / count;
+    console.log(label + ": " + ms.toFixed(3) + " ms/query (" + (found / count).toFixed(1) + " results)");
+}
+
+// -- populate ----------------------------------------------------------------
+
+var app = new standin.StandInApp();
+var context = app.context();
+var scores = app.bucketWithName("scores");
+
+var start = Date.now();
+for (var n = 0; n < SCORE_COUNT; n++) {
+    var location = randomLocation();
+    var object = scores.createObject();
+    object.set("score", Math.floor(Math.pow(random(), 2) * 300));
+    object.set("username", "player" + n);
+    object.setGeoPoint("location", location);
+    object.set("geocell", server.geocellFor(location.latitude, location.longitude, PRECISION));
+    object.save();
+
+    // run the real hook so the per-cell boards are built the way the server does it
+    server.onScoreCreated({ uri: object.objectURI() }, context, function() {});
+}
+console.log("populated " + SCORE_COUNT + " scores in " + ((Date.now() - start) / 1000).toFixed(1) + "s");
+
+// -- query -------------------------------------------------------------------
+
+var centers = [];
+for (var q = 0; q < QUERY_COUNT; q++) {
+    centers.push(randomLocation());
+}
+
+var topQuery = function(clause) {
+    var query = standin.KiiQuery.queryWithClause(clause);
+    query.sortByDesc("score");
+    query.setLimit(TOP);
+    return query;
+};
+
+var resultCount = function(bucket, query) {
+    var count = 0;
+    bucket.executeQuery(query, { success: function(query, results) { count = results.length; } });
+    return count;
+};
+
+time("radius scan    ", Math.max(1, Math.floor(QUERY_COUNT / 20)), function(i) {
+    return resultCount(scores, topQuery(standin.KiiClause.geoDistance("location", centers[i], RADIUS)));
+});
+
+time("geocell lookup ", QUERY_COUNT, function(i) {
+    return resultCount(scores, topQuery(standin.KiiClause.inClause("geocell", cellsAround(centers[i]))));
+});
+
+var leaderboard = app.bucketWithName("leaderboard");
+time("regional boards", QUERY_COUNT, function(i) {
+    var boards = cellsAround(centers[i]).map(function(cell) { return "geo:" + cell; });
+    var merged = [];
+    leaderboard.executeQuery(standin.KiiQuery.queryWithClause(standin.KiiClause.inClause("board", boards)), {
+        success: function(query, results) {
+            results.forEach(function(board) { merged = merged.concat(board.get("entries")); });
+        }
+    });
+    merged.sort(function(a, b) { return b.s - a.s; });
+    return Math.min(merged.length, TOP);
+});
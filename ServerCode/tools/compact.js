@@ -0,0 +1,220 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+// Runs the archival compaction job (compactScores in kiiblocks.js) against
+// the local stand-in: fills the 'scores' bucket with synthetic games spread
+// over the past few months, compacts everything older than
+// ARCHIVE_AFTER_DAYS, and checks that every old game ended up in exactly one
+// per-day sketch and in its player's best - including after runs that die
+// halfway through saving a folded batch, between folding a batch and noting
+// how far they got, and halfway through deleting a batch. Also times a
+// top-20 query on the bucket before and after.
+//
+// usage: node compact.js [scoreCount] [playerCount] [days]
+//
+
+var standin = require("./standin.js");
+var server = require("../kiiblocks.js");
+
+var SCORE_COUNT = parseInt(process.argv[2] || "100000", 10);
+var PLAYER_COUNT = parseInt(process.argv[3] || "2000", 10);
+var DAYS = parseInt(process.argv[4] || "90", 10);
+
+var DAY_MILLIS = 24 * 60 * 60 * 1000;
+var NOW = Date.UTC(2013, 11, 31, 12);
+var CUTOFF = NOW - server.ARCHIVE_AFTER_DAYS * DAY_MILLIS;
+
+// a small deterministic generator so every run sees the same data
+var seed = 42;
+function random() {
+    seed = (seed * 1103515245 + 12345) % 2147483648;
+    return seed / 2147483648;
+}
+
+function assert(condition, message) {
+    if (!condition) {
+        console.log("FAILED: " + message);
+        process.exit(1);
+    }
+}
+
+function dayOf(millis) {
+    return new Date(millis).toISOString().substring(0, 10);
+}
+
+// -- populate ----------------------------------------------------------------
+
+var app = new standin.StandInApp();
+var context = app.context();
+var scores = app.bucketWithName("scores");
+
+var expectedBests = {};
+var expectedDays = {};
+var oldCount = 0;
+
+for (var n = 0; n < SCORE_COUNT; n++) {
+    var player = Math.floor(random() * PLAYER_COUNT);
+    var score = Math.floor(Math.pow(random(), 2) * 300);
+
+    var object = scores.createObject();
+    object.set("score", score);
+    object.set("username", "player" + player);
+    object._owner = "user" + player;
+    object._created = NOW - Math.floor(random() * DAYS * DAY_MILLIS);
+    object.save();
+
+    if (object._created < CUTOFF) {
+        var best = expectedBests["user" + player] || (expectedBests["user" + player] = { best: 0, games: 0 });
+        best.best = Math.max(best.best, score);
+        best.games++;
+
+        var day = dayOf(object._created);
+        expectedDays[day] = (expectedDays[day] || 0) + 1;
+        ++oldCount;
+    }
+}
+
+function timeTopQuery() {
+    var query = standin.KiiQuery.queryWithClause(null);
+    query.sortByDesc("score");
+    query.setLimit(20);
+
+    var start = process.hrtime();
+    for (var i = 0; i < 10; i++) {
+        scores.executeQuery(query, { success: function() {} });
+    }
+    var elapsed = process.hrtime(start);
+    return (elapsed[0] * 1e3 + elapsed[1] / 1e6) / 10;
+}
+
+console.log(SCORE_COUNT + " scores from " + PLAYER_COUNT + " players over " + DAYS + " days, " +
+            oldCount + " older than " + server.ARCHIVE_AFTER_DAYS + " days");
+var queryBefore = timeTopQuery();
+
+// -- compact -----------------------------------------------------------------
+
+// runs die at a few points along the way - none of them may get a score
+// folded twice or lost:
+//
+//   - partway through saving the players' bests of a folded batch
+//   - after a batch was folded, when noting how far the run got
+//   - partway through deleting a batch, after it was folded and noted
+var objectPrototype = Object.getPrototypeOf(scores.createObject());
+var realSave = objectPrototype.save;
+var realSaveAllFields = objectPrototype.saveAllFields;
+var realDelete = objectPrototype["delete"];
+
+var bestSavesUntilFailure = 700;
+var stateSavesUntilFailure = 20;
+var deletesUntilFailure = 2250;
+
+function failAt(counter, bucketName) {
+    return function(object) {
+        return object._bucket.getBucketName() === bucketName && counter.left > 0 && --counter.left === 0;
+    };
+}
+
+var bestFailure = failAt({ left: bestSavesUntilFailure }, "bests");
+var stateFailure = failAt({ left: stateSavesUntilFailure }, "archive");
+var deleteFailure = failAt({ left: deletesUntilFailure }, "scores");
+
+objectPrototype.save = function(callbacks) {
+    if (bestFailure(this)) {
+        callbacks.failure(this, "simulated failure saving a best");
+        return;
+    }
+    realSave.call(this, callbacks);
+};
+
+// the state is the only thing in the archive saved with saveAllFields; every
+// other save of it is a checkpoint after a fold
+var stateSaves = 0;
+objectPrototype.saveAllFields = function(callbacks, overwrite) {
+    if (this.get("board") === "state:compaction" && ++stateSaves % 2 === 0 && stateFailure(this)) {
+        callbacks.failure(this, "simulated failure noting progress");
+        return;
+    }
+    realSaveAllFields.call(this, callbacks, overwrite);
+};
+
+objectPrototype["delete"] = function(callbacks) {
+    if (deleteFailure(this)) {
+        callbacks.failure(this, "simulated failure deleting a score");
+        return;
+    }
+    realDelete.call(this, callbacks);
+};
+
+var runs = 0;
+var batches = 0;
+var failures = 0;
+var finished = false;
+var start = Date.now();
+
+// one batch per run, so every batch also goes through picking up where the
+// previous run stopped
+while (!finished) {
+    server.compactScores({ now: NOW, maxBatches: 1 }, context, function(response) {
+        ++runs;
+        batches += response.result.batches;
+        failures += response.error ? 1 : 0;
+        finished = response.result.finished;
+    });
+}
+
+var seconds = (Date.now() - start) / 1000;
+console.log("compacted in " + seconds.toFixed(1) + "s: " + runs + " runs, " + batches + " batches, " +
+            failures + " failed run(s)");
+
+// -- check -------------------------------------------------------------------
+
+var remaining = 0;
+for (var id in scores._objects) {
+    assert(scores._objects[id]._created >= CUTOFF, "an old score was left behind");
+    ++remaining;
+}
+assert(remaining === SCORE_COUNT - oldCount, "recent scores were deleted");
+
+var bests = app.bucketWithName("bests");
+var bestCount = 0;
+for (var bestID in bests._objects) {
+    var bestObject = bests._objects[bestID];
+    var expected = expectedBests[bestObject.get("user")];
+    assert(expected && expected.best === bestObject.get("best") && expected.games === bestObject.get("games"),
+           "wrong best for " + bestObject.get("user"));
+    ++bestCount;
+}
+assert(bestCount === Object.keys(expectedBests).length, "players missing from bests");
+
+var archive = app.bucketWithName("archive");
+var dayCount = 0;
+for (var dayID in archive._objects) {
+    var dayObject = archive._objects[dayID];
+    var board = dayObject.get("board");
+    if (board.indexOf("hist:") !== 0) {
+        continue;
+    }
+    var counted = dayObject.get("z") + dayObject.get("c").reduce(function(a, b) { return a + b; }, 0);
+    assert(dayObject.get("n") === expectedDays[board.substring(5)] && counted === dayObject.get("n"),
+           "wrong count for " + board);
+    ++dayCount;
+}
+assert(dayCount === Object.keys(expectedDays).length, "days missing from the archive");
+
+console.log("ok: " + remaining + " scores left, " + bestCount + " player bests, " + dayCount + " day sketches");
+console.log("top 20 query: " + queryBefore.toFixed(2) + "ms before, " + timeTopQuery().toFixed(2) + "ms after");
@@ -0,0 +1,410 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+// A local, in-memory stand-in for the parts of the Kii Cloud server code
+// API that kiiblocks.js uses. It lets us run the server code and measure
+// query strategies under node without touching a real application.
+//
+// Callbacks are invoked synchronously. Equality and 'in' clauses are served
+// from a per-field hash index (like an indexed field on the server), every
+// other clause falls back to scanning the whole bucket. Tools can backdate
+// an object by setting object._created before it is first saved, and make a
+// user its owner (as if they had saved it) by setting object._owner to their id.
+//
+// Like the server, a bucket hands out copies: changing an object does
+// nothing until it is saved, and saveAllFields(callbacks, false) fails if
+// the object was changed (or, for one created with an ID, created) by
+// someone else since it was read. Tools can look at what is stored through
+// bucket._objects.
+//
+
+var EARTH_RADIUS = 6371000;
+
+// -- geo points --------------------------------------------------------------
+
+function KiiGeoPoint(latitude, longitude) {
+    this.latitude = latitude;
+    this.longitude = longitude;
+}
+KiiGeoPoint.create = function(latitude, longitude) {
+    return new KiiGeoPoint(latitude, longitude);
+};
+KiiGeoPoint.prototype.getLatitude = function() { return this.latitude; };
+KiiGeoPoint.prototype.getLongitude = function() { return this.longitude; };
+
+function distanceBetween(a, b) {
+    var toRad = Math.PI / 180;
+    var dLat = (b.latitude - a.latitude) * toRad;
+    var dLon = (b.longitude - a.longitude) * toRad;
+    var h = Math.sin(dLat / 2) * Math.sin(dLat / 2) +
+            Math.cos(a.latitude * toRad) * Math.cos(b.latitude * toRad) *
+            Math.sin(dLon / 2) * Math.sin(dLon / 2);
+    return 2 * EARTH_RADIUS * Math.asin(Math.sqrt(h));
+}
+
+// -- clauses and queries -----------------------------------------------------
+
+function KiiClause(type, key, value) {
+    this.type = type;
+    this.key = key;
+    this.value = value;
+}
+KiiClause.equals = function(key, value) { return new KiiClause("eq", key, value); };
+KiiClause.notEquals = function(key, value) { return new KiiClause("ne", key, value); };
+KiiClause.greaterThan = function(key, value) { return new KiiClause("gt", key, value); };
+KiiClause.greaterThanOrEqual = function(key, value) { return new KiiClause("ge", key, value); };
+KiiClause.lessThan = function(key, value) { return new KiiClause("lt", key, value); };
+KiiClause.lessThanOrEqual = function(key, value) { return new KiiClause("le", key, value); };
+KiiClause.inClause = function(key, values) { return new KiiClause("in", key, values); };
+KiiClause.and = function() { return new KiiClause("and", null, Array.prototype.slice.call(arguments)); };
+KiiClause.or = function() { return new KiiClause("or", null, Array.prototype.slice.call(arguments)); };
+KiiClause.geoDistance = function(key, center, radius) {
+    return new KiiClause("geo", key, { center: center, radius: radius });
+};
+
+// the value of a field, including the built-in '_created' time
+function fieldOf(object, key) {
+    return (key === "_created") ? object._created : object._fields[key];
+}
+
+KiiClause.prototype.matches = function(object) {
+    var field = (this.key === null) ? undefined : fieldOf(object, this.key);
+
+    switch (this.type) {
+        case "eq": return field === this.value;
+        case "ne": return field !== this.value;
+        case "gt": return field > this.value;
+        case "ge": return field >= this.value;
+        case "lt": return field < this.value;
+        case "le": return field <= this.value;
+        case "in": return this.value.indexOf(field) >= 0;
+        case "and": return this.value.every(function(c) { return c.matches(object); });
+        case "or": return this.value.some(function(c) { return c.matches(object); });
+        case "geo": return field instanceof KiiGeoPoint &&
+                           distanceBetween(field, this.value.center) <= this.value.radius;
+    }
+    throw new Error("unsupported clause " + this.type);
+};
+
+function KiiQuery(clause) {
+    this.clause = clause || null;
+    this.limit = 0;
+    this.sortField = null;
+    this.sortDescending = false;
+}
+KiiQuery.queryWithClause = function(clause) { return new KiiQuery(clause); };
+KiiQuery.prototype.setLimit = function(limit) { this.limit = limit; };
+KiiQuery.prototype.sortByDesc = function(field) { this.sortField = field; this.sortDescending = true; };
+KiiQuery.prototype.sortByAsc = function(field) { this.sortField = field; this.sortDescending = false; };
+
+// -- objects -----------------------------------------------------------------
+
+var nextObjectID = 1;
+
+// a copy of a field value, so objects never share arrays or nested objects
+function cloneValue(value) {
+    if (Array.isArray(value)) {
+        return value.map(cloneValue);
+    }
+    if (value !== null && typeof value === "object" && !(value instanceof KiiGeoPoint)) {
+        var copy = {};
+        for (var key in value) {
+            copy[key] = cloneValue(value[key]);
+        }
+        return copy;
+    }
+    return value;
+}
+
+function KiiObject(bucket, id) {
+    this._bucket = bucket;
+    this._fields = {};
+    this._id = id || null;
+    this._created = Date.now();
+
+    // the id of the user who created the object, if a user did
+    this._owner = null;
+
+    // the version of the stored object this copy was read at (null if it
+    // hasn't been saved or read yet)
+    this._version = null;
+}
+KiiObject.prototype.get = function(key) { return this._fields[key]; };
+KiiObject.prototype.getGeoPoint = function(key) {
+    var value = this._fields[key];
+    return (value instanceof KiiGeoPoint) ? value : null;
+};
+KiiObject.prototype.set = function(key, value) { this._fields[key] = value; };
+KiiObject.prototype.setGeoPoint = KiiObject.prototype.set;
+KiiObject.prototype.getCreated = function() { return this._created; };
+KiiObject.prototype.getOwner = function() {
+    return (this._owner === null) ? null : new KiiUser(this._owner, null);
+};
+KiiObject.prototype.getUUID = function() { return this._id; };
+KiiObject.prototype.objectURI = function() {
+    return "kiicloud://buckets/" + this._bucket._name + "/objects/" + this._id;
+};
+
+// a copy of this object as it is now
+KiiObject.prototype._copy = function() {
+    var copy = new KiiObject(this._bucket, this._id);
+    copy._fields = cloneValue(this._fields);
+    copy._created = this._created;
+    copy._owner = this._owner;
+    copy._version = this._version;
+    return copy;
+};
+
+KiiObject.prototype._write = function(overwrite, callbacks) {
+    var stored = (this._id === null) ? undefined : this._bucket._objects[this._id];
+
+    if (!overwrite && stored && stored._version !== this._version) {
+        if (callbacks) callbacks.failure(this, "OBJECT_VERSION_IS_STALE");
+        return;
+    }
+
+    if (this._id === null) {
+        this._id = String(nextObjectID++);
+    }
+    if (stored) {
+        this._created = stored._created;
+        this._owner = stored._owner;
+    }
+    this._version = stored ? stored._version + 1 : 1;
+    this._bucket._insert(this._copy());
+
+    if (callbacks) callbacks.success(this);
+};
+KiiObject.prototype.save = function(callbacks) { this._write(true, callbacks); };
+KiiObject.prototype.saveAllFields = function(callbacks, overwrite) {
+    this._write(overwrite !== false, callbacks);
+};
+KiiObject.prototype.refresh = function(callbacks) {
+    var stored = this._bucket._objects[this._id];
+    if (!stored) {
+        callbacks.failure(this, "OBJECT_NOT_FOUND");
+        return;
+    }
+    this._fields = cloneValue(stored._fields);
+    this._created = stored._created;
+    this._owner = stored._owner;
+    this._version = stored._version;
+    callbacks.success(this);
+};
+KiiObject.prototype["delete"] = function(callbacks) {
+    var stored = this._bucket._objects[this._id];
+    if (stored) {
+        this._bucket._remove(stored);
+    }
+    if (callbacks) callbacks.success(this);
+};
+
+// -- buckets -----------------------------------------------------------------
+
+function KiiBucket(name) {
+    this._name = name;
+    this._objects = {};
+    this._indexes = {};
+}
+KiiBucket.prototype.getBucketName = function() { return this._name; };
+KiiBucket.prototype.createObject = function() { return new KiiObject(this); };
+KiiBucket.prototype.createObjectWithID = function(id) { return new KiiObject(this, id); };
+
+KiiBucket.prototype._insert = function(object) {
+    var old = this._objects[object._id];
+    if (old) {
+        this._unindex(old);
+    }
+    this._objects[object._id] = object;
+    this._index(object);
+};
+KiiBucket.prototype._remove = function(object) {
+    this._unindex(object);
+    delete this._objects[object._id];
+};
+KiiBucket.prototype._index = function(object) {
+    for (var key in this._indexes) {
+        var index = this._indexes[key];
+        var value = object._fields[key];
+        if (!index.has(value)) index.set(value, new Set());
+        index.get(value).add(object);
+    }
+};
+KiiBucket.prototype._unindex = function(object) {
+    for (var key in this._indexes) {
+        var set = this._indexes[key].get(object._fields[key]);
+        if (set) set["delete"](object);
+    }
+};
+
+// build a hash index on a field the first time it is used for equality
+KiiBucket.prototype._indexFor = function(key) {
+    if (!this._indexes[key]) {
+        var index = new Map();
+        for (var id in this._objects) {
+            var value = this._objects[id]._fields[key];
+            if (!index.has(value)) index.set(value, new Set());
+            index.get(value).add(this._objects[id]);
+        }
+        this._indexes[key] = index;
+    }
+    return this._indexes[key];
+};
+
+// the smallest set of objects that can satisfy the clause
+KiiBucket.prototype._candidates = function(clause) {
+    var self = this;
+
+    if (clause === null) {
+        return Object.keys(this._objects).map(function(id) { return self._objects[id]; });
+    }
+    if (clause.type === "eq") {
+        return Array.from(this._indexFor(clause.key).get(clause.value) || []);
+    }
+    if (clause.type === "in") {
+        var index = this._indexFor(clause.key);
+        var found = [];
+        clause.value.forEach(function(value) {
+            (index.get(value) || []).forEach(function(object) { found.push(object); });
+        });
+        return found;
+    }
+    if (clause.type === "and") {
+        for (var i = 0; i < clause.value.length; i++) {
+            if (clause.value[i].type === "eq" || clause.value[i].type === "in") {
+                return this._candidates(clause.value[i]);
+            }
+        }
+    }
+    return this._candidates(null);
+};
+
+KiiBucket.prototype.executeQuery = function(query, callbacks) {
+    var results = this._candidates(query.clause).filter(function(object) {
+        return query.clause === null || query.clause.matches(object);
+    });
+
+    if (query.sortField !== null) {
+        var field = query.sortField, direction = query.sortDescending ? -1 : 1;
+        results.sort(function(a, b) {
+            var x = fieldOf(a, field), y = fieldOf(b, field);
+            return (x < y ? -1 : (x > y ? 1 : 0)) * direction;
+        });
+    }
+
+    var nextQuery = null;
+    if (query.limit > 0 && results.length > query.limit) {
+        results = results.slice(0, query.limit);
+    }
+    results = results.map(function(object) { return object._copy(); });
+
+    callbacks.success(query, results, nextQuery);
+};
+
+KiiBucket.prototype.count = function() {
+    return Object.keys(this._objects).length;
+};
+
+// -- push --------------------------------------------------------------------
+
+function KiiPushMessageBuilder(data) {
+    this.data = data;
+}
+KiiPushMessageBuilder.prototype.build = function() {
+    return { data: this.data };
+};
+
+function KiiTopic(name, app) {
+    this._name = name;
+    this._app = app;
+}
+KiiTopic.prototype.sendMessage = function(message, callbacks) {
+    this._app.sentMessages.push({ topic: this._name, data: message.data });
+    callbacks.success(this, message);
+};
+
+// -- users and groups --------------------------------------------------------
+
+function KiiGroup(uri, app) {
+    this._uri = uri;
+    this._app = app;
+}
+KiiGroup.prototype.objectURI = function() { return this._uri; };
+KiiGroup.prototype.bucketWithName = function(name) {
+    return this._app.bucketWithName(this._uri + "/" + name);
+};
+
+function KiiUser(id, app) {
+    this._id = id;
+    this._app = app;
+}
+KiiUser.prototype.getID = function() { return this._id; };
+KiiUser.prototype.memberOfGroups = function(callbacks) {
+    var app = this._app;
+    var groups = (app.memberships[this._id] || []).map(function(uri) { return new KiiGroup(uri, app); });
+    callbacks.success(this, groups);
+};
+
+// -- the application ---------------------------------------------------------
+
+// a fresh, empty application. use app.context() wherever server code
+// expects the 'context' argument
+function StandInApp() {
+    this.buckets = {};
+    this.sentMessages = [];
+    this.memberships = {};
+}
+StandInApp.prototype.bucketWithName = function(name) {
+    if (!this.buckets[name]) {
+        this.buckets[name] = new KiiBucket(name);
+    }
+    return this.buckets[name];
+};
+StandInApp.prototype.topicWithName = function(name) { return new KiiTopic(name, this); };
+StandInApp.prototype.userWithID = function(id) { return new KiiUser(id, this); };
+StandInApp.prototype.groupWithURI = function(uri) { return new KiiGroup(uri, this); };
+StandInApp.prototype.objectWithURI = function(uri) {
+    var match = /^kiicloud:\/\/buckets\/(.+)\/objects\/([^\/]+)$/.exec(uri);
+    var bucket = this.bucketWithName(match[1]);
+    var stored = bucket._objects[match[2]];
+
+    // like the server, an object for the uri - refresh() reads it
+    return stored ? stored._copy() : bucket.createObjectWithID(match[2]);
+};
+StandInApp.prototype.context = function() {
+    var app = this;
+    return { getAppAdminContext: function() { return app; } };
+};
+
+// put the API classes where server code expects to find them
+function install(scope) {
+    scope.KiiGeoPoint = KiiGeoPoint;
+    scope.KiiClause = KiiClause;
+    scope.KiiQuery = KiiQuery;
+    scope.KiiPushMessageBuilder = KiiPushMessageBuilder;
+}
+
+install(global);
+
+module.exports = {
+    StandInApp: StandInApp,
+    KiiGeoPoint: KiiGeoPoint,
+    KiiClause: KiiClause,
+    KiiQuery: KiiQuery,
+    distanceBetween: distanceBetween
+};
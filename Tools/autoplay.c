@@ -0,0 +1,452 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+// A headless auto-player for balancing: plays many games of each board
+// configuration across all cores and reports the score distribution, so we
+// can see what strong play scores before touching LEVEL_TIME, the color count
+// or the board size in MyScene.
+//
+// Games are split into chunks and dealt out to one queue per worker thread.
+// A worker takes chunks from the back of its own queue and, once that runs
+// dry, steals from the front of the others. Every worker has its own boards
+// and its own random number stream for rollouts; each game's board is seeded
+// from the game number, so every policy plays the same deals.
+//
+// policies:
+//
+//   random  - tap any cluster that can be busted
+//   greedy  - tap the biggest cluster
+//   mc      - Monte Carlo: for every cluster, play a few random games a few
+//             taps deep from it (over sampled refills) and tap the best on average.
+//             the rollouts run on the packed board, which plays by the same rules
+//
+// a configuration is COLUMNSxROWSxCOLORS@SECONDS, e.g. 6x7x4@5 is the game as
+// it ships. the number of taps in a game is SECONDS x the taps per second
+//
+// build (from this directory):
+//
+//   cc -std=gnu99 -O2 -pthread -I../KiiBlocks/KiiBlocks -o autoplay autoplay.c
+//      ../KiiBlocks/KiiBlocks/Board.c ../KiiBlocks/KiiBlocks/BoardAdjacency.c
+//      ../KiiBlocks/KiiBlocks/PackedBoard.c -lm
+//
+// (add -mbmi2 on cpus that have it)
+//
+// usage:  ./autoplay [-p random|greedy|mc] [-g games] [-t threads] [-r rollouts]
+//                    [-d depth] [-s tapsPerSecond] [-m minBust] [config ...]
+//
+
+#include "Board.h"
+#include "PackedBoard.h"
+#include "Clock.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// how many games make up one unit of work
+#define GAMES_PER_CHUNK     16
+
+typedef enum {
+    POLICY_RANDOM,
+    POLICY_GREEDY,
+    POLICY_MC
+} Policy;
+
+typedef struct {
+    int columns;
+    int rows;
+    int colors;
+    float seconds;
+    
+    // the score of every game, filled in by whichever worker played it
+    int *scores;
+} Config;
+
+typedef struct {
+    int config;
+    int firstGame;
+    int gameCount;
+} Chunk;
+
+// a worker's queue of chunks. the owner works from the back, thieves from the front
+typedef struct {
+    pthread_mutex_t lock;
+    Chunk *chunks;
+    int front;
+    int back;
+} Queue;
+
+typedef struct {
+    int index;
+    pthread_t thread;
+    
+    // this worker's own boards and random numbers. rollouts start from a
+    // packed copy of the game's board
+    KBBoard *board;
+    KBPackedBoard packed;
+    KBPackedBoard scratch;
+    KBRandom random;
+    
+    // every tap played, including the ones inside rollouts
+    uint64_t taps;
+    uint64_t games;
+    uint64_t steals;
+} Worker;
+
+static Config *configs;
+static int configCount;
+static Queue *queues;
+static Worker *workers;
+static int workerCount;
+
+static Policy policy = POLICY_MC;
+static int rollouts = 4;
+static int depth = 4;
+static float tapsPerSecond = 4.f;
+static int minBust = 2;
+static uint64_t baseSeed = 2013;
+
+// spreads consecutive numbers into unrelated seeds
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static int takeChunk(Queue *queue, int fromBack, Chunk *chunk)
+{
+    int taken = 0;
+    
+    pthread_mutex_lock(&queue->lock);
+    if(queue->front < queue->back) {
+        *chunk = fromBack ? queue->chunks[--queue->back] : queue->chunks[queue->front++];
+        taken = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    
+    return taken;
+}
+
+// a random cluster that can be busted - a few random cells usually find one,
+// otherwise walk the board from a random starting point
+static int randomMove(const KBBoard *board, KBRandom *random)
+{
+    int cells = board->columns * board->rows;
+    
+    for(int attempt=0; attempt<8; attempt++) {
+        int n = KBRandomBelow(random, cells);
+        int col = n / board->rows;
+        int row = n % board->rows;
+        if(KBBoardClusterSize(board, col, row) >= board->minBust) {
+            return BOARD_INDEX(col, row);
+        }
+    }
+    
+    int start = KBRandomBelow(random, cells);
+    for(int i=0; i<cells; i++) {
+        int n = (start + i) % cells;
+        int col = n / board->rows;
+        int row = n % board->rows;
+        if(KBBoardClusterSize(board, col, row) >= board->minBust) {
+            return BOARD_INDEX(col, row);
+        }
+    }
+    
+    return -1;
+}
+
+static int tap(Worker *worker, KBBoard *board, int index)
+{
+    ++worker->taps;
+    return KBBoardTap(board, index / BOARD_MAX_ROWS, index % BOARD_MAX_ROWS, NULL);
+}
+
+// the same as randomMove, on a packed board
+static int randomPackedMove(const KBPackedBoard *board, KBRandom *random)
+{
+    int cells = board->columns * board->rows;
+    int start = KBRandomBelow(random, cells);
+    
+    for(int i=0; i<cells; i++) {
+        int n = (i < 8) ? (int)KBRandomBelow(random, cells) : (start + i) % cells;
+        int col = n / board->rows;
+        int row = n % board->rows;
+        if(KBPackedBoardClusterSize(board, col, row) >= board->minBust) {
+            return BOARD_INDEX(col, row);
+        }
+    }
+    
+    return -1;
+}
+
+static int packedTap(Worker *worker, KBPackedBoard *board, int index)
+{
+    ++worker->taps;
+    return KBPackedBoardTap(board, index / BOARD_MAX_ROWS, index % BOARD_MAX_ROWS);
+}
+
+// pick the next move for a game with 'remaining' taps to go
+static int chooseMove(Worker *worker, int remaining)
+{
+    KBBoard *board = worker->board;
+    
+    if(policy == POLICY_RANDOM) {
+        return randomMove(board, &worker->random);
+    }
+    
+    if(policy == POLICY_MC) {
+        KBPackedBoardFromBoard(&worker->packed, board);
+    }
+    
+    // the representative of every cluster that can be busted is a candidate
+    int best = -1;
+    double bestValue = -1.0;
+    
+    for(int col=0; col<board->columns; col++) {
+        for(int row=0; row<board->rows; row++) {
+            int index = BOARD_INDEX(col, row);
+            if(board->label[index] != index || board->size[index] < board->minBust) {
+                continue;
+            }
+            
+            double value = board->size[index];
+            
+            if(policy == POLICY_MC && board->movableClusters > 1) {
+                
+                // play it out a few times - the refills are unknown, so each
+                // rollout gets its own random numbers
+                int steps = (depth < remaining-1) ? depth : remaining-1;
+                uint64_t total = 0;
+                
+                for(int r=0; r<rollouts; r++) {
+                    worker->scratch = worker->packed;
+                    KBPackedBoardSetRefillSeed(&worker->scratch, ((uint64_t)KBRandomNext(&worker->random) << 32) | KBRandomNext(&worker->random));
+                    
+                    total += packedTap(worker, &worker->scratch, index);
+                    for(int step=0; step<steps; step++) {
+                        int move = randomPackedMove(&worker->scratch, &worker->random);
+                        if(move < 0) {
+                            break;
+                        }
+                        total += packedTap(worker, &worker->scratch, move);
+                    }
+                }
+                
+                value = (double)total / rollouts;
+            }
+            
+            if(value > bestValue) {
+                bestValue = value;
+                best = index;
+            }
+        }
+    }
+    
+    return best;
+}
+
+static void playChunk(Worker *worker, const Chunk *chunk)
+{
+    Config *config = &configs[chunk->config];
+    int taps = (int)(config->seconds * tapsPerSecond + 0.5f);
+    
+    for(int game=chunk->firstGame; game<chunk->firstGame+chunk->gameCount; game++) {
+        
+        // the deal depends only on the configuration and the game number
+        uint64_t seed = splitmix64(baseSeed ^ ((uint64_t)chunk->config << 40) ^ (uint64_t)game);
+        KBBoardInit(worker->board, config->columns, config->rows, config->colors, minBust, seed);
+        
+        int score = 0;
+        for(int i=0; i<taps; i++) {
+            
+            // the board reshuffles whenever it runs out of moves, so this
+            // shouldn't happen - but if it does, the game is over
+            int move = chooseMove(worker, taps-i);
+            if(move < 0) {
+                break;
+            }
+            score += tap(worker, worker->board, move);
+        }
+        
+        config->scores[game] = score;
+        ++worker->games;
+    }
+}
+
+static void *runWorker(void *argument)
+{
+    Worker *worker = argument;
+    Chunk chunk;
+    
+    for(;;) {
+        
+        // our own work first, newest chunk first
+        if(takeChunk(&queues[worker->index], 1, &chunk)) {
+            playChunk(worker, &chunk);
+            continue;
+        }
+        
+        // then steal the oldest chunk from someone else
+        int stolen = 0;
+        for(int i=1; i<workerCount && !stolen; i++) {
+            stolen = takeChunk(&queues[(worker->index + i) % workerCount], 0, &chunk);
+        }
+        
+        if(!stolen) {
+            break;
+        }
+        
+        ++worker->steals;
+        playChunk(worker, &chunk);
+    }
+    
+    return NULL;
+}
+
+static int compareScores(const void *a, const void *b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+static int parseConfig(const char *text, Config *config)
+{
+    return sscanf(text, "%dx%dx%d@%f", &config->columns, &config->rows, &config->colors, &config->seconds) == 4
+        && config->columns >= 1 && config->columns <= BOARD_MAX_COLUMNS
+        && config->rows >= 1 && config->rows <= BOARD_MAX_ROWS
+        && config->colors >= 1 && config->colors <= PACKED_BOARD_MAX_COLORS
+        && config->seconds > 0.f;
+}
+
+int main(int argc, char **argv)
+{
+    int games = 1000;
+    workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    
+    int option;
+    while((option = getopt(argc, argv, "p:g:t:r:d:s:m:")) != -1) {
+        switch(option) {
+            case 'p':
+                if(strcmp(optarg, "random") == 0) policy = POLICY_RANDOM;
+                else if(strcmp(optarg, "greedy") == 0) policy = POLICY_GREEDY;
+                else if(strcmp(optarg, "mc") == 0) policy = POLICY_MC;
+                else { fprintf(stderr, "unknown policy %s\n", optarg); return 1; }
+                break;
+            case 'g': games = atoi(optarg); break;
+            case 't': workerCount = atoi(optarg); break;
+            case 'r': rollouts = atoi(optarg); break;
+            case 'd': depth = atoi(optarg); break;
+            case 's': tapsPerSecond = atof(optarg); break;
+            case 'm': minBust = atoi(optarg); break;
+            default: return 1;
+        }
+    }
+    
+    if(games < 1 || workerCount < 1 || rollouts < 1 || depth < 0 || tapsPerSecond <= 0.f || minBust < 1) {
+        fprintf(stderr, "games, threads, rollouts, taps per second and minBust must be positive\n");
+        return 1;
+    }
+    
+    // the shipping game, unless told otherwise
+    const char *defaults[] = { "6x7x4@5" };
+    char **names = (optind < argc) ? &argv[optind] : (char**)defaults;
+    configCount = (optind < argc) ? argc - optind : 1;
+    
+    configs = calloc(configCount, sizeof(Config));
+    for(int i=0; i<configCount; i++) {
+        if(!parseConfig(names[i], &configs[i])) {
+            fprintf(stderr, "bad configuration '%s' (expected COLUMNSxROWSxCOLORS@SECONDS, up to %d colors)\n", names[i], PACKED_BOARD_MAX_COLORS);
+            return 1;
+        }
+        configs[i].scores = calloc(games, sizeof(int));
+    }
+    
+    // deal the chunks out round robin, so every worker starts with a mix of configurations
+    int chunksPerConfig = (games + GAMES_PER_CHUNK - 1) / GAMES_PER_CHUNK;
+    int chunkCount = chunksPerConfig * configCount;
+    
+    queues = calloc(workerCount, sizeof(Queue));
+    for(int i=0; i<workerCount; i++) {
+        pthread_mutex_init(&queues[i].lock, NULL);
+        queues[i].chunks = calloc(chunkCount / workerCount + 1, sizeof(Chunk));
+    }
+    
+    for(int i=0; i<chunkCount; i++) {
+        Chunk chunk;
+        chunk.config = i % configCount;
+        chunk.firstGame = (i / configCount) * GAMES_PER_CHUNK;
+        chunk.gameCount = (games - chunk.firstGame < GAMES_PER_CHUNK) ? games - chunk.firstGame : GAMES_PER_CHUNK;
+        
+        Queue *queue = &queues[i % workerCount];
+        queue->chunks[queue->back++] = chunk;
+    }
+    
+    printf("%d games per configuration, %s policy, %d threads\n", games,
+           (policy == POLICY_RANDOM) ? "random" : (policy == POLICY_GREEDY) ? "greedy" : "mc", workerCount);
+    
+    uint64_t started = KBClockMicros();
+    
+    workers = calloc(workerCount, sizeof(Worker));
+    for(int i=0; i<workerCount; i++) {
+        workers[i].index = i;
+        workers[i].board = malloc(sizeof(KBBoard));
+        KBRandomSeed(&workers[i].random, splitmix64(baseSeed + 0x5EED + i));
+        pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]);
+    }
+    
+    uint64_t taps = 0;
+    uint64_t steals = 0;
+    for(int i=0; i<workerCount; i++) {
+        pthread_join(workers[i].thread, NULL);
+        taps += workers[i].taps;
+        steals += workers[i].steals;
+    }
+    
+    double seconds = (KBClockMicros() - started) / 1e6;
+    
+    // the score distribution of each configuration
+    printf("\n%-14s %8s %8s %6s %6s %6s %6s %6s\n", "config", "mean", "stddev", "p10", "p50", "p90", "p99", "max");
+    
+    for(int i=0; i<configCount; i++) {
+        Config *config = &configs[i];
+        qsort(config->scores, games, sizeof(int), compareScores);
+        
+        double sum = 0, squares = 0;
+        for(int game=0; game<games; game++) {
+            sum += config->scores[game];
+            squares += (double)config->scores[game] * config->scores[game];
+        }
+        double mean = sum / games;
+        double variance = squares / games - mean * mean;
+        
+        printf("%-14s %8.1f %8.1f %6d %6d %6d %6d %6d\n", names[i], mean, sqrt(variance > 0 ? variance : 0),
+               config->scores[games / 10], config->scores[games / 2],
+               config->scores[games * 9 / 10], config->scores[games * 99 / 100], config->scores[games-1]);
+    }
+    
+    printf("\n%.2f s, %.1f games/s, %.2f M taps/s (%.2f M per thread), %llu chunks stolen\n",
+           seconds, games * configCount / seconds, taps / seconds / 1e6, taps / seconds / 1e6 / workerCount,
+           (unsigned long long)steals);
+    
+    return 0;
+}
@@ -0,0 +1,130 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+// Benchmarks the hint engine headless, on the same board code the app runs.
+// Plays games by always tapping the hint and reports how long hints take and
+// what they score, with and without lookahead:
+//
+//   greedy       - biggest cluster, no lookahead
+//   lookahead N  - N taps ahead over sampled refills, within the budget
+//   + table      - the same, with a transposition table kept between hints
+//
+// build (from this directory):
+//
+//   cc -std=gnu99 -O2 -I../KiiBlocks/KiiBlocks -o hintbench hintbench.c
+//      ../KiiBlocks/KiiBlocks/Board.c ../KiiBlocks/KiiBlocks/BoardAdjacency.c
+//      ../KiiBlocks/KiiBlocks/BoardHint.c ../KiiBlocks/KiiBlocks/TranspositionTable.c
+//      ../KiiBlocks/KiiBlocks/Histogram.c -lm
+//
+// usage:  ./hintbench [columns] [rows] [colors] [minBust] [budgetMicros] [taps] [lookahead]
+//
+
+#include "Board.h"
+#include "BoardAdjacency.h"
+#include "BoardHint.h"
+#include "Histogram.h"
+#include "TranspositionTable.h"
+#include "Clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void run(const char *name, int columns, int rows, int colors, int minBust, uint64_t budget, int lookahead, KBTranspositionTable *table, int taps)
+{
+    KBBoard *board = malloc(sizeof(KBBoard));
+    KBBoardInit(board, columns, rows, colors, minBust, 2013);
+    
+    KBHistogram latency;
+    KBHistogramInitExponential(&latency, 1, 1.5);
+    
+    uint64_t removed = 0;
+    uint64_t evaluated = 0;
+    uint64_t candidates = 0;
+    uint64_t positions = 0;
+    uint64_t tableHits = 0;
+    
+    for(int i=0; i<taps; i++) {
+        KBHint hint;
+        
+        uint64_t started = KBClockMicros();
+        KBBoardHint(board, budget, lookahead, table, &hint);
+        KBHistogramAdd(&latency, (double)(KBClockMicros() - started));
+        
+        evaluated += hint.evaluated;
+        candidates += hint.candidates;
+        positions += hint.positions;
+        tableHits += hint.tableHits;
+        removed += KBBoardTap(board, hint.column, hint.row, NULL);
+    }
+    
+    printf("%-16s  p50 %8.1f us  p99 %8.1f us  rated %5.1f%% of clusters  %6.2f blocks/tap  %8.0f positions/hint  %5.1f%% from table\n",
+           name,
+           KBHistogramPercentile(&latency, 0.5),
+           KBHistogramPercentile(&latency, 0.99),
+           100.0 * evaluated / candidates,
+           (double)removed / taps,
+           (double)positions / taps,
+           positions ? 100.0 * tableHits / positions : 0.0);
+    
+    free(board);
+}
+
+int main(int argc, char **argv)
+{
+    int columns = (argc > 1) ? atoi(argv[1]) : 6;
+    int rows = (argc > 2) ? atoi(argv[2]) : 7;
+    int colors = (argc > 3) ? atoi(argv[3]) : 4;
+    int minBust = (argc > 4) ? atoi(argv[4]) : 2;
+    uint64_t budget = (argc > 5) ? strtoull(argv[5], NULL, 10) : 2000;
+    int taps = (argc > 6) ? atoi(argv[6]) : 2000;
+    int lookahead = (argc > 7) ? atoi(argv[7]) : 2;
+    
+    if(lookahead < 1 || lookahead > HINT_MAX_LOOKAHEAD) {
+        fprintf(stderr, "lookahead must be between 1 and %d\n", HINT_MAX_LOOKAHEAD);
+        return 1;
+    }
+    
+    if(columns < 1 || columns > BOARD_MAX_COLUMNS || rows < 1 || rows > BOARD_MAX_ROWS || colors < 1 || colors > 255) {
+        fprintf(stderr, "board must be between 1x1 and %dx%d with 1-255 colors\n", BOARD_MAX_COLUMNS, BOARD_MAX_ROWS);
+        return 1;
+    }
+    
+    printf("%dx%d board, %d colors, clusters of %d+, %llu us budget, %d taps (%s kernel)\n",
+           columns, rows, colors, minBust, (unsigned long long)budget, taps, KBAdjacencyKernel());
+    
+    // a 4MB table, the same one for every hint in a run
+    KBTranspositionTable *table = KBTranspositionTableCreate(18);
+    
+    run("greedy", columns, rows, colors, minBust, budget, 0, NULL, taps);
+    
+    for(int depth=1; depth<=lookahead; depth++) {
+        char name[32];
+        
+        snprintf(name, sizeof(name), "lookahead %d", depth);
+        run(name, columns, rows, colors, minBust, budget, depth, NULL, taps);
+        
+        snprintf(name, sizeof(name), "lookahead %d+table", depth);
+        KBTranspositionTableClear(table);
+        run(name, columns, rows, colors, minBust, budget, depth, table, taps);
+    }
+    
+    KBTranspositionTableDestroy(table);
+    
+    return 0;
+}
@@ -0,0 +1,168 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+// Benchmarks the score sketch the server keeps for 'top x%' ranks: how fast
+// scores go in, how fast the sketches of several shards merge, how small it
+// stays and how far its answers are from the exact ones. The scores are
+// made up - mostly ordinary games with a long tail of very good ones.
+//
+// build (from this directory):
+//
+//   cc -std=gnu99 -O2 -I../KiiBlocks/KiiBlocks -o sketchbench sketchbench.c
+//      ../KiiBlocks/KiiBlocks/ScoreSketch.c -lm
+//
+// usage:  ./sketchbench [scores] [shards]
+//
+
+#include "ScoreSketch.h"
+#include "Clock.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// the scores are clamped to this so the exact answers can come from a plain count
+#define MAX_SCORE   1000000
+
+// xorshift64*, the same generator the board uses - kept here so the bench
+// only depends on the sketch
+static uint32_t nextRandom(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (uint32_t)((*state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// a made-up score: log-normal around 20 with a long tail, and a few games
+// that never got going
+static uint32_t randomScore(uint64_t *random)
+{
+    if((uint32_t)(((uint64_t)nextRandom(random) * 100) >> 32) < 2) {
+        return 0;
+    }
+    
+    double u1 = (nextRandom(random) + 1.0) / 4294967297.0;
+    double u2 = (nextRandom(random) + 1.0) / 4294967297.0;
+    double normal = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+    
+    double score = round(exp(3.0 + 0.9 * normal));
+    return (score > MAX_SCORE) ? MAX_SCORE : (uint32_t)score;
+}
+
+int main(int argc, char **argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : 10000000;
+    int shardCount = (argc > 2) ? atoi(argv[2]) : 8;
+    
+    uint32_t *scores = malloc(count * sizeof(uint32_t));
+    uint64_t *exact = calloc(MAX_SCORE + 1, sizeof(uint64_t));
+    
+    uint64_t random = 2013;
+    for(int i=0; i<count; i++) {
+        scores[i] = randomScore(&random);
+        ++exact[scores[i]];
+    }
+    
+    // updates: every score into its shard, as the server code does
+    KBScoreSketch *shards = malloc(shardCount * sizeof(KBScoreSketch));
+    for(int s=0; s<shardCount; s++) {
+        KBScoreSketchInit(&shards[s]);
+    }
+    
+    uint64_t started = KBClockMicros();
+    for(int i=0; i<count; i++) {
+        KBScoreSketchAdd(&shards[i % shardCount], scores[i]);
+    }
+    double updateSeconds = (KBClockMicros() - started) / 1e6;
+    
+    // merges: what a client does with the shards it fetched
+    KBScoreSketch merged;
+    int merges = 0;
+    started = KBClockMicros();
+    while(KBClockMicros() - started < 500000) {
+        KBScoreSketchInit(&merged);
+        for(int s=0; s<shardCount; s++) {
+            KBScoreSketchMerge(&merged, &shards[s]);
+        }
+        merges += shardCount;
+    }
+    double mergeSeconds = (KBClockMicros() - started) / 1e6;
+    
+    printf("%d scores, %d shards\n", count, shardCount);
+    printf("update  %.1f M scores/s\n", count / updateSeconds / 1e6);
+    printf("merge   %.2f M sketches/s\n", merges / mergeSeconds / 1e6);
+    
+    // how much of the sketch is in use - the server only stores that span
+    int first = SCORE_SKETCH_BUCKETS, last = -1;
+    for(int i=0; i<SCORE_SKETCH_BUCKETS; i++) {
+        if(merged.buckets[i]) {
+            if(i < first) first = i;
+            last = i;
+        }
+    }
+    printf("size    %d buckets in use (%d..%d)\n", last - first + 1, first, last);
+    
+    // quantiles against the exact ones
+    printf("\nquantile     exact    sketch   error\n");
+    double fractions[] = { 0.5, 0.75, 0.9, 0.99, 0.999, 0.9999 };
+    for(int f=0; f<(int)(sizeof(fractions)/sizeof(fractions[0])); f++) {
+        uint64_t rank = (uint64_t)(fractions[f] * (count - 1));
+        uint64_t seen = 0;
+        int score = 0;
+        while(seen + exact[score] <= rank) {
+            seen += exact[score++];
+        }
+        
+        double estimate = KBScoreSketchQuantile(&merged, fractions[f]);
+        double error = (score > 0) ? fabs(estimate - score) / score : estimate;
+        printf("%-8g %9d %9.1f   %.2f%%\n", fractions[f], score, estimate, error * 100);
+    }
+    
+    // ranks against the exact ones, for every score somebody got. 'above'
+    // counts ties as half, as the sketch does
+    uint64_t above = count;
+    double worst = 0;
+    int worstScore = 0;
+    double weighted = 0;
+    
+    for(int score=0; score<=MAX_SCORE; score++) {
+        if(exact[score] == 0) {
+            continue;
+        }
+        above -= exact[score];
+        
+        double truth = (above + exact[score] / 2.0) / count;
+        double error = fabs(KBScoreSketchFractionAbove(&merged, score) - truth);
+        
+        if(error > worst) {
+            worst = error;
+            worstScore = score;
+        }
+        weighted += error * exact[score];
+    }
+    
+    printf("\nrank error  max %.3f points (at a score of %d), average per player %.4f points\n",
+           worst * 100, worstScore, weighted / count * 100);
+    
+    free(shards);
+    free(exact);
+    free(scores);
+    return 0;
+}
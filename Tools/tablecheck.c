@@ -0,0 +1,71 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+// Checks the transposition table keeps to its contract: a value is only
+// handed back for the position and the search depth it was stored for. The
+// hint engine's values add up over depth (the most the next n taps can
+// remove), so a value from a deeper search would overstate a shallower one.
+// Exits with 1 and says what went wrong if anything does.
+//
+// build (from this directory):
+//
+//   cc -std=gnu99 -O2 -I../KiiBlocks/KiiBlocks -o tablecheck tablecheck.c
+//      ../KiiBlocks/KiiBlocks/TranspositionTable.c
+//
+// usage:  ./tablecheck
+//
+
+#include "TranspositionTable.h"
+
+#include <stdio.h>
+
+static int failures = 0;
+
+static void expect(int condition, const char *what)
+{
+    printf("%-56s %s\n", what, condition ? "ok" : "FAILED");
+    failures += !condition;
+}
+
+int main(void)
+{
+    KBTranspositionTable *table = KBTranspositionTableCreate(10);
+    uint64_t key = 0x0123456789ABCDEFULL;
+    uint32_t value = 0;
+    
+    KBTranspositionTableStore(table, key, 3, 17);
+    
+    expect(KBTranspositionTableProbe(table, key, 3, &value) && value == 17, "same depth finds the value");
+    expect(!KBTranspositionTableProbe(table, key, 2, &value), "a deeper entry isn't used for a shallower probe");
+    expect(!KBTranspositionTableProbe(table, key, 1, &value), "nor for a much shallower one");
+    expect(!KBTranspositionTableProbe(table, key, 4, &value), "a shallower entry isn't used for a deeper probe");
+    expect(!KBTranspositionTableProbe(table, key ^ 1, 3, &value), "another position doesn't match");
+    
+    // every depth of a position is kept apart
+    KBTranspositionTableStore(table, key, 2, 9);
+    expect(KBTranspositionTableProbe(table, key, 2, &value) && value == 9, "a shallower value has a slot of its own");
+    expect(KBTranspositionTableProbe(table, key, 3, &value) && value == 17, "and leaves the deeper one alone");
+    
+    KBTranspositionTableClear(table);
+    expect(!KBTranspositionTableProbe(table, key, 3, &value), "clearing forgets everything");
+    
+    KBTranspositionTableDestroy(table);
+    
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,923 @@
+//
+//
+// Copyright 2013 Kii Corporation
+// http://kii.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+
+// Batch replay validator: checks submitted games by replaying their taps on
+// the game rules and comparing the score with the one claimed. Reads a file
+// of replay records (see Replay.h) and writes one verdict per record, in the
+// same order, to the output file:
+//
+//   struct { uint32_t score; uint8_t verdict; uint8_t reserved[3]; }
+//
+// where score is the score the replay actually came to, by the scoring rules
+// the record carries (a point a block if it has none). Both files are
+// memory-mapped, so a whole day's dump goes through without being copied.
+// Records are handed out in chunks to a pool of worker threads, each with
+// one board set up once and reused for every game it checks.
+//
+// The rules and board a record carries come from the client, so they are
+// only taken if they are those of a mode players can be given: the modes
+// shipped in GameModes.json, or those in the cloud 'modes' bucket (exported
+// as a JSON list with the same keys). A record that matches none of them
+// gets an 'unknown mode' verdict without being replayed. -m reads the known
+// modes from the given file instead of the shipped one - give it once for
+// GameModes.json and once for the export of the bucket.
+//
+// It can also generate a file of made-up submissions of the known modes to
+// try it on, some of them with inflated scores and some scored by forged
+// rules, and check itself on a few made-up games (-T, exits with 1 if a
+// verdict isn't the one it should be).
+//
+// build (from this directory):
+//
+//   cc -std=gnu99 -O2 -pthread -I../KiiBlocks/KiiBlocks -o validate validate.c
+//      ../KiiBlocks/KiiBlocks/Board.c ../KiiBlocks/KiiBlocks/BoardAdjacency.c
+//      ../KiiBlocks/KiiBlocks/PackedBoard.c ../KiiBlocks/KiiBlocks/Scoring.c
+//
+// (add -mbmi2 on cpus that have it)
+//
+// usage:  ./validate [-t threads] [-m modes.json]... input verdicts
+//         ./validate -G count [-s seed] [-m modes.json]... output
+//         ./validate -T [-m modes.json]...
+//
+
+#include "Board.h"
+#include "PackedBoard.h"
+#include "Replay.h"
+#include "Scoring.h"
+#include "Clock.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// how many records a worker takes at a time
+#define RECORDS_PER_CHUNK   1024
+
+// the modes the app ships with, from this directory
+#define SHIPPED_MODES_PATH  "../KiiBlocks/KiiBlocks/GameModes.json"
+
+// how many known modes (shipped and in the cloud) we can take
+#define MAX_KNOWN_MODES     64
+
+// the most taps a made-up game has
+#define MAX_GENERATED_TAPS  512
+
+typedef enum {
+    VERDICT_VALID,
+    VERDICT_SCORE_MISMATCH,     // the taps don't add up to the claimed score
+    VERDICT_BAD_TAP,            // a tap outside the board
+    VERDICT_BAD_TIMING,         // taps out of order or after the time ran out
+    VERDICT_MALFORMED,          // a header we can't make sense of, or a cut-off record
+    VERDICT_UNKNOWN_MODE,       // a board or scoring rules no known mode has
+    VERDICT_COUNT
+} Verdict;
+
+static const char *verdictNames[VERDICT_COUNT] = {
+    "valid", "score mismatch", "bad tap", "bad timing", "malformed", "unknown mode"
+};
+
+typedef struct {
+    uint32_t score;
+    uint8_t verdict;
+    uint8_t reserved[3];
+} KBReplayVerdict;
+
+static const uint8_t *input;
+static uint64_t inputSize;
+static uint64_t *offsets;
+static uint64_t recordCount;
+static KBReplayVerdict *verdicts;
+
+// the next chunk of records to hand out
+static uint64_t nextChunk;
+
+// a mode players can be given, with its scoring rules worked out the same
+// way GameMode does
+typedef struct {
+    char name[64];
+    int columns;
+    int rows;
+    int colorCount;
+    int minBust;
+    uint32_t timeLimitMillis;
+    KBScoringRules rules;
+} KnownMode;
+
+static KnownMode knownModes[MAX_KNOWN_MODES];
+static int knownModeCount;
+
+// just enough of a JSON reader for a list of modes: objects, lists, strings,
+// numbers and literals, where anything that isn't a mode key is skipped
+typedef struct {
+    const char *at;
+    const char *end;
+} JSONReader;
+
+static void skipSpace(JSONReader *reader)
+{
+    while(reader->at < reader->end && isspace((unsigned char)*reader->at)) {
+        reader->at++;
+    }
+}
+
+// take the next character if it's the one given
+static int take(JSONReader *reader, char c)
+{
+    skipSpace(reader);
+    if(reader->at < reader->end && *reader->at == c) {
+        reader->at++;
+        return 1;
+    }
+    return 0;
+}
+
+// a string, cut short to fit. escapes are kept as they are - mode names and
+// keys don't need them
+static int readString(JSONReader *reader, char *string, size_t size)
+{
+    if(!take(reader, '"')) {
+        return 0;
+    }
+    
+    size_t length = 0;
+    while(reader->at < reader->end && *reader->at != '"') {
+        if(*reader->at == '\\' && reader->at + 1 < reader->end) {
+            if(length + 1 < size) {
+                string[length++] = *reader->at;
+            }
+            reader->at++;
+        }
+        if(length + 1 < size) {
+            string[length++] = *reader->at;
+        }
+        reader->at++;
+    }
+    string[length] = 0;
+    
+    return take(reader, '"');
+}
+
+static int readNumber(JSONReader *reader, double *number)
+{
+    skipSpace(reader);
+    
+    char buffer[64];
+    size_t length = 0;
+    while(reader->at < reader->end && length < sizeof(buffer) - 1
+          && (isdigit((unsigned char)*reader->at) || strchr("+-.eE", *reader->at) != NULL) && *reader->at != 0) {
+        buffer[length++] = *reader->at++;
+    }
+    buffer[length] = 0;
+    
+    char *end;
+    *number = strtod(buffer, &end);
+    return length > 0 && *end == 0;
+}
+
+static int skipValue(JSONReader *reader, int depth)
+{
+    skipSpace(reader);
+    if(reader->at >= reader->end || depth > 32) {
+        return 0;
+    }
+    
+    char c = *reader->at;
+    char ignored[1];
+    double number;
+    
+    if(c == '"') {
+        return readString(reader, ignored, sizeof(ignored));
+    }
+    if(c == '{' || c == '[') {
+        char close = (c == '{') ? '}' : ']';
+        reader->at++;
+        if(take(reader, close)) {
+            return 1;
+        }
+        do {
+            if(c == '{' && (!readString(reader, ignored, sizeof(ignored)) || !take(reader, ':'))) {
+                return 0;
+            }
+            if(!skipValue(reader, depth + 1)) {
+                return 0;
+            }
+        } while(take(reader, ','));
+        return take(reader, close);
+    }
+    if(isalpha((unsigned char)c)) {
+        while(reader->at < reader->end && isalpha((unsigned char)*reader->at)) {
+            reader->at++;
+        }
+        return 1;
+    }
+    return readNumber(reader, &number);
+}
+
+// a list of numbers, no more than maxCount of them. *count is -1 if it
+// doesn't fit or holds something other than a number
+static int readNumberList(JSONReader *reader, double *values, int maxCount, int *count)
+{
+    if(!take(reader, '[')) {
+        *count = -1;
+        return skipValue(reader, 0);
+    }
+    
+    *count = 0;
+    if(take(reader, ']')) {
+        return 1;
+    }
+    
+    do {
+        double number;
+        skipSpace(reader);
+        if(reader->at < reader->end && *reader->at != '-' && !isdigit((unsigned char)*reader->at)) {
+            *count = -1;
+            if(!skipValue(reader, 0)) {
+                return 0;
+            }
+            continue;
+        }
+        if(!readNumber(reader, &number)) {
+            return 0;
+        }
+        if(*count >= 0 && *count < maxCount) {
+            values[(*count)++] = number;
+        } else {
+            *count = -1;
+        }
+    } while(take(reader, ','));
+    
+    return take(reader, ']');
+}
+
+// a list of non-negative numbers none bigger than the C core can hold, or
+// no list at all
+static int isNumberList(const double *values, int count, double maxValue)
+{
+    if(count < 0) {
+        return 0;
+    }
+    for(int i=0; i<count; i++) {
+        if(values[i] < 0 || values[i] > maxValue) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// read one mode object. returns -1 if it can't be read, 0 if it isn't a
+// mode the app would play (GameMode's modeWithDictionary: turns it down
+// for the same reasons), 1 if it is one
+static int readMode(JSONReader *reader, KnownMode *mode)
+{
+    double columns = -1, rows = -1, minBust = -1, colors = -1, timeLimit = -1;
+    double chainWindow = 0, colorClearBonus = 0;
+    double scoring[SCORING_MAX_STEPS], colorBonus[SCORING_MAX_COLORS], chain[SCORING_MAX_CHAIN];
+    int scoringCount = 0, colorBonusCount = 0, chainCount = 0;
+    int named = 0, numbers = 1;
+    
+    memset(mode, 0, sizeof(KnownMode));
+    
+    if(!take(reader, '{')) {
+        return -1;
+    }
+    if(!take(reader, '}')) {
+        do {
+            char key[32];
+            if(!readString(reader, key, sizeof(key)) || !take(reader, ':')) {
+                return -1;
+            }
+            
+            double *number = NULL;
+            if(strcmp(key, "columns") == 0) number = &columns;
+            else if(strcmp(key, "rows") == 0) number = &rows;
+            else if(strcmp(key, "minBust") == 0) number = &minBust;
+            else if(strcmp(key, "colors") == 0) number = &colors;
+            else if(strcmp(key, "timeLimit") == 0) number = &timeLimit;
+            else if(strcmp(key, "chainWindow") == 0) number = &chainWindow;
+            else if(strcmp(key, "colorClearBonus") == 0) number = &colorClearBonus;
+            
+            int read;
+            skipSpace(reader);
+            if(number != NULL) {
+                if(reader->at < reader->end && (*reader->at == '-' || isdigit((unsigned char)*reader->at))) {
+                    read = readNumber(reader, number);
+                } else {
+                    numbers = 0;
+                    read = skipValue(reader, 0);
+                }
+            } else if(strcmp(key, "name") == 0 && reader->at < reader->end && *reader->at == '"') {
+                named = 1;
+                read = readString(reader, mode->name, sizeof(mode->name));
+            } else if(strcmp(key, "scoring") == 0) {
+                read = readNumberList(reader, scoring, SCORING_MAX_STEPS, &scoringCount);
+            } else if(strcmp(key, "colorBonus") == 0) {
+                read = readNumberList(reader, colorBonus, SCORING_MAX_COLORS, &colorBonusCount);
+            } else if(strcmp(key, "chain") == 0) {
+                read = readNumberList(reader, chain, SCORING_MAX_CHAIN, &chainCount);
+            } else {
+                read = skipValue(reader, 0);
+            }
+            if(!read) {
+                return -1;
+            }
+        } while(take(reader, ','));
+        
+        if(!take(reader, '}')) {
+            return -1;
+        }
+    }
+    
+    if(!named || !numbers
+       || (int)columns < 1 || (int)columns > BOARD_MAX_COLUMNS
+       || (int)rows < 1 || (int)rows > BOARD_MAX_ROWS
+       || (int)minBust < 1 || (int)minBust > (int)columns * (int)rows
+       || (int)colors < 1 || (int)colors > SCORING_MAX_COLORS
+       || timeLimit <= 0
+       || !isNumberList(scoring, scoringCount, UINT32_MAX)
+       || !isNumberList(colorBonus, colorBonusCount, UINT16_MAX)
+       || !isNumberList(chain, chainCount, UINT16_MAX)
+       || chainWindow < 0 || chainWindow * 1000 > UINT32_MAX
+       || colorClearBonus < 0 || colorClearBonus > UINT32_MAX) {
+        return 0;
+    }
+    
+    mode->columns = (int)columns;
+    mode->rows = (int)rows;
+    mode->minBust = (int)minBust;
+    mode->colorCount = (int)colors;
+    mode->timeLimitMillis = (uint32_t)(timeLimit * 1000);
+    
+    KBScoringRulesDefault(&mode->rules);
+    mode->rules.stepCount = (uint32_t)scoringCount;
+    for(int i=0; i<scoringCount; i++) {
+        mode->rules.steps[i] = (uint32_t)scoring[i];
+    }
+    for(int i=0; i<colorBonusCount; i++) {
+        mode->rules.colorPercent[i] = (uint16_t)colorBonus[i];
+    }
+    // like the app, a mode without a chain has no window either
+    mode->rules.chainWindowMillis = (chainCount > 0) ? (uint32_t)(chainWindow * 1000) : 0;
+    mode->rules.chainCount = (uint32_t)chainCount;
+    for(int i=0; i<chainCount; i++) {
+        mode->rules.chainPercent[i] = (uint16_t)chain[i];
+    }
+    mode->rules.colorClearBonus = (uint32_t)colorClearBonus;
+    
+    return 1;
+}
+
+// add the modes in a JSON list of them to the known ones
+static int loadModes(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) {
+        perror(path);
+        return 0;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    char *text = malloc(size > 0 ? (size_t)size : 1);
+    size_t length = fread(text, 1, size > 0 ? (size_t)size : 0, file);
+    fclose(file);
+    
+    JSONReader reader = { text, text + length };
+    int loaded = take(&reader, '[');
+    
+    if(loaded && !take(&reader, ']')) {
+        do {
+            KnownMode mode;
+            int read = readMode(&reader, &mode);
+            
+            if(read < 0) {
+                loaded = 0;
+                break;
+            }
+            if(read == 0) {
+                fprintf(stderr, "%s: skipping a mode the app wouldn't play\n", path);
+                continue;
+            }
+            if(knownModeCount == MAX_KNOWN_MODES) {
+                fprintf(stderr, "%s: more than %d modes\n", path, MAX_KNOWN_MODES);
+                loaded = 0;
+                break;
+            }
+            knownModes[knownModeCount++] = mode;
+        } while(take(&reader, ','));
+        
+        loaded = loaded && take(&reader, ']');
+    }
+    
+    free(text);
+    
+    if(!loaded) {
+        fprintf(stderr, "%s isn't a list of modes\n", path);
+    }
+    return loaded;
+}
+
+// a record of a mode is set up the way the app sets a game of it up, and
+// scored by its rules (which a mode without rules of its own doesn't send)
+static int isRecordOfMode(const KnownMode *mode, const KBReplayHeader *header, const KBScoringRules *rules)
+{
+    return header->columns == mode->columns && header->rows == mode->rows
+        && header->colorCount == mode->colorCount && header->minBust == mode->minBust
+        && header->timeLimitMillis == mode->timeLimitMillis
+        && memcmp(rules, &mode->rules, sizeof(KBScoringRules)) == 0;
+}
+
+static const KnownMode *knownModeOfRecord(const KBReplayHeader *header, const KBScoringRules *rules)
+{
+    for(int i=0; i<knownModeCount; i++) {
+        if(isRecordOfMode(&knownModes[i], header, rules)) {
+            return &knownModes[i];
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    pthread_t thread;
+    
+    // set up once, reused for every game. the packed board handles up to 8
+    // colors, the full board is only there for anything bigger
+    KBPackedBoard packed;
+    KBBoard *board;
+    
+    // the mode of the last game and the tables for its scoring rules, built
+    // again only when the next game is of a different mode
+    const KnownMode *mode;
+    KBScoringTables *tables;
+    
+    uint64_t counts[VERDICT_COUNT];
+} Worker;
+
+static Verdict validate(Worker *worker, const KBReplayHeader *header, uint64_t available, uint32_t *score)
+{
+    *score = 0;
+    
+    if(available < sizeof(KBReplayHeader) || header->magic != REPLAY_MAGIC
+       || (header->rulesSize != 0 && header->rulesSize != sizeof(KBScoringRules))
+       || KBReplayRecordSize(header) > available
+       || header->columns < 1 || header->columns > BOARD_MAX_COLUMNS
+       || header->rows < 1 || header->rows > BOARD_MAX_ROWS
+       || header->colorCount < 1 || header->minBust < 1) {
+        return VERDICT_MALFORMED;
+    }
+    
+    KBScoringRules rules;
+    if(header->rulesSize) {
+        memcpy(&rules, KBReplayRules(header), sizeof(rules));
+    } else {
+        KBScoringRulesDefault(&rules);
+    }
+    
+    // games mostly come in runs of the same mode
+    if(worker->mode == NULL || !isRecordOfMode(worker->mode, header, &rules)) {
+        const KnownMode *mode = knownModeOfRecord(header, &rules);
+        if(mode == NULL) {
+            return VERDICT_UNKNOWN_MODE;
+        }
+        
+        if(worker->tables == NULL) {
+            worker->tables = malloc(sizeof(KBScoringTables));
+        }
+        KBScoringTablesBuild(worker->tables, &mode->rules, mode->columns, mode->rows);
+        worker->mode = mode;
+    }
+    
+    int packed = KBPackedBoardInit(&worker->packed, header->columns, header->rows, header->colorCount, header->minBust, header->seed);
+    if(!packed) {
+        if(worker->board == NULL) {
+            worker->board = malloc(sizeof(KBBoard));
+        }
+        KBBoardInit(worker->board, header->columns, header->rows, header->colorCount, header->minBust, header->seed);
+    }
+    
+    KBScoringChain chain;
+    KBScoringChainReset(&chain);
+    
+    const KBReplayTap *taps = KBReplayTaps(header);
+    uint32_t lastMillis = 0;
+    uint32_t total = 0;
+    
+    for(uint32_t i=0; i<header->tapCount; i++) {
+        const KBReplayTap *tap = &taps[i];
+        
+        if(tap->millis < lastMillis || tap->millis > header->timeLimitMillis) {
+            return VERDICT_BAD_TIMING;
+        }
+        if(tap->column >= header->columns || tap->row >= header->rows) {
+            return VERDICT_BAD_TAP;
+        }
+        
+        // the cluster's color, and whether it's all of that color, before it goes
+        int color = packed ? KBPackedBoardColorAt(&worker->packed, tap->column, tap->row)
+                           : KBBoardColorAt(worker->board, tap->column, tap->row);
+        int colorCount = packed ? KBPackedBoardColorCount(&worker->packed, color)
+                                : KBBoardColorCount(worker->board, color);
+        
+        // taps on clusters too small to bust are allowed - they just do nothing
+        int removed = packed ? KBPackedBoardTap(&worker->packed, tap->column, tap->row)
+                             : KBBoardTap(worker->board, tap->column, tap->row, NULL);
+        if(removed > 0) {
+            total = KBScoringAdd(total, KBScoringTap(worker->tables, &chain, removed, color, removed == colorCount, tap->millis));
+        }
+        lastMillis = tap->millis;
+    }
+    
+    *score = total;
+    return (total == header->claimedScore) ? VERDICT_VALID : VERDICT_SCORE_MISMATCH;
+}
+
+static void *runWorker(void *argument)
+{
+    Worker *worker = argument;
+    
+    for(;;) {
+        uint64_t chunk = __atomic_fetch_add(&nextChunk, 1, __ATOMIC_RELAXED);
+        uint64_t first = chunk * RECORDS_PER_CHUNK;
+        
+        if(first >= recordCount) {
+            break;
+        }
+        
+        uint64_t last = (first + RECORDS_PER_CHUNK < recordCount) ? first + RECORDS_PER_CHUNK : recordCount;
+        
+        for(uint64_t i=first; i<last; i++) {
+            const KBReplayHeader *header = (const KBReplayHeader*)(input + offsets[i]);
+            uint32_t score;
+            
+            Verdict verdict = validate(worker, header, inputSize - offsets[i], &score);
+            
+            verdicts[i].score = score;
+            verdicts[i].verdict = (uint8_t)verdict;
+            ++worker->counts[verdict];
+        }
+    }
+    
+    return NULL;
+}
+
+static int runValidation(const char *inputPath, const char *outputPath, int workerCount)
+{
+    int inputFile = open(inputPath, O_RDONLY);
+    struct stat info;
+    
+    if(inputFile < 0 || fstat(inputFile, &info) != 0) {
+        perror(inputPath);
+        return 1;
+    }
+    
+    inputSize = (uint64_t)info.st_size;
+    if(inputSize == 0) {
+        fprintf(stderr, "%s is empty\n", inputPath);
+        return 1;
+    }
+    
+    input = mmap(NULL, inputSize, PROT_READ, MAP_PRIVATE, inputFile, 0);
+    if(input == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    madvise((void*)input, inputSize, MADV_SEQUENTIAL);
+    
+    uint64_t started = KBClockMicros();
+    
+    // find where every record starts. a record we can't find the end of is
+    // the last one - it gets a 'malformed' verdict
+    uint64_t capacity = 1024;
+    offsets = malloc(capacity * sizeof(uint64_t));
+    
+    for(uint64_t offset=0; offset<inputSize; ) {
+        if(recordCount == capacity) {
+            capacity *= 2;
+            offsets = realloc(offsets, capacity * sizeof(uint64_t));
+        }
+        offsets[recordCount++] = offset;
+        
+        const KBReplayHeader *header = (const KBReplayHeader*)(input + offset);
+        if(inputSize - offset < sizeof(KBReplayHeader) || header->magic != REPLAY_MAGIC) {
+            break;
+        }
+        offset += KBReplayRecordSize(header);
+    }
+    
+    // the verdicts go straight into the output file
+    int outputFile = open(outputPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    uint64_t outputSize = recordCount * sizeof(KBReplayVerdict);
+    
+    if(outputFile < 0 || ftruncate(outputFile, (off_t)outputSize) != 0) {
+        perror(outputPath);
+        return 1;
+    }
+    
+    verdicts = mmap(NULL, outputSize, PROT_READ | PROT_WRITE, MAP_SHARED, outputFile, 0);
+    if(verdicts == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    
+    Worker *workers = calloc(workerCount, sizeof(Worker));
+    for(int i=0; i<workerCount; i++) {
+        pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]);
+    }
+    
+    uint64_t counts[VERDICT_COUNT] = { 0 };
+    for(int i=0; i<workerCount; i++) {
+        pthread_join(workers[i].thread, NULL);
+        for(int v=0; v<VERDICT_COUNT; v++) {
+            counts[v] += workers[i].counts[v];
+        }
+        free(workers[i].board);
+        free(workers[i].tables);
+    }
+    
+    double seconds = (KBClockMicros() - started) / 1e6;
+    
+    munmap(verdicts, outputSize);
+    munmap((void*)input, inputSize);
+    close(outputFile);
+    close(inputFile);
+    
+    printf("%llu records, %d threads, %.3f s, %.0f games/s\n",
+           (unsigned long long)recordCount, workerCount, seconds, recordCount / seconds);
+    for(int v=0; v<VERDICT_COUNT; v++) {
+        printf("  %-16s %llu\n", verdictNames[v], (unsigned long long)counts[v]);
+    }
+    
+    return 0;
+}
+
+// play a made-up game of a mode by tapping random cells four times a second
+// or so until the time is up, scored by the given rules (the mode's, unless
+// they're being forged). fills in the header - claiming the score the taps
+// come to - and the taps
+static void playGame(const KnownMode *mode, const KBScoringRules *rules, KBRandom *random,
+                     KBReplayHeader *header, KBReplayTap *taps)
+{
+    KBScoringRules plain;
+    KBScoringRulesDefault(&plain);
+    
+    memset(header, 0, sizeof(KBReplayHeader));
+    header->magic = REPLAY_MAGIC;
+    header->columns = (uint8_t)mode->columns;
+    header->rows = (uint8_t)mode->rows;
+    header->colorCount = (uint8_t)mode->colorCount;
+    header->minBust = (uint8_t)mode->minBust;
+    header->seed = ((uint64_t)KBRandomNext(random) << 32) | KBRandomNext(random);
+    header->timeLimitMillis = mode->timeLimitMillis;
+    
+    // like the app, rules that are just a point a block aren't sent
+    header->rulesSize = memcmp(rules, &plain, sizeof(plain)) ? sizeof(KBScoringRules) : 0;
+    
+    KBScoringTables *tables = malloc(sizeof(KBScoringTables));
+    KBScoringTablesBuild(tables, rules, mode->columns, mode->rows);
+    
+    KBScoringChain chain;
+    KBScoringChainReset(&chain);
+    
+    KBPackedBoard packedBoard;
+    KBBoard *board = NULL;
+    int packed = KBPackedBoardInit(&packedBoard, mode->columns, mode->rows, mode->colorCount, mode->minBust, header->seed);
+    if(!packed) {
+        board = malloc(sizeof(KBBoard));
+        KBBoardInit(board, mode->columns, mode->rows, mode->colorCount, mode->minBust, header->seed);
+    }
+    
+    uint32_t millis = 0;
+    while(header->tapCount < MAX_GENERATED_TAPS) {
+        millis += 150 + KBRandomBelow(random, 200);
+        if(millis > header->timeLimitMillis) {
+            break;
+        }
+        
+        KBReplayTap *tap = &taps[header->tapCount++];
+        memset(tap, 0, sizeof(KBReplayTap));
+        tap->millis = millis;
+        tap->column = (uint8_t)KBRandomBelow(random, header->columns);
+        tap->row = (uint8_t)KBRandomBelow(random, header->rows);
+        
+        int color = packed ? KBPackedBoardColorAt(&packedBoard, tap->column, tap->row)
+                           : KBBoardColorAt(board, tap->column, tap->row);
+        int colorCount = packed ? KBPackedBoardColorCount(&packedBoard, color)
+                                : KBBoardColorCount(board, color);
+        int removed = packed ? KBPackedBoardTap(&packedBoard, tap->column, tap->row)
+                             : KBBoardTap(board, tap->column, tap->row, NULL);
+        if(removed > 0) {
+            header->claimedScore = KBScoringAdd(header->claimedScore, KBScoringTap(tables, &chain, removed, color, removed == colorCount, millis));
+        }
+    }
+    
+    free(board);
+    free(tables);
+}
+
+// rules a cheat might send along instead of their mode's: every clear worth
+// ten times as much
+static void forgeRules(const KnownMode *mode, KBScoringRules *forged)
+{
+    *forged = mode->rules;
+    for(int c=0; c<SCORING_MAX_COLORS; c++) {
+        forged->colorPercent[c] = (uint16_t)(mode->rules.colorPercent[c] * 10);
+    }
+}
+
+// write made-up submissions: games of each of the known modes in turn, with
+// one in ten claiming more than it got and one in twenty scored by forged
+// rules that it carries (and claims what they come to)
+static int generate(const char *outputPath, uint64_t count, uint64_t seed)
+{
+    FILE *output = fopen(outputPath, "wb");
+    if(output == NULL) {
+        perror(outputPath);
+        return 1;
+    }
+    
+    KBRandom random;
+    KBRandomSeed(&random, seed);
+    
+    KBReplayTap *taps = malloc(MAX_GENERATED_TAPS * sizeof(KBReplayTap));
+    uint64_t inflated = 0;
+    uint64_t forged = 0;
+    
+    for(uint64_t i=0; i<count; i++) {
+        const KnownMode *mode = &knownModes[i % knownModeCount];
+        KBScoringRules rules = mode->rules;
+        
+        if(KBRandomBelow(&random, 20) == 0) {
+            forgeRules(mode, &rules);
+            ++forged;
+        }
+        
+        KBReplayHeader header;
+        playGame(mode, &rules, &random, &header, taps);
+        
+        if(KBRandomBelow(&random, 10) == 0) {
+            header.claimedScore += 1 + KBRandomBelow(&random, 20);
+            ++inflated;
+        }
+        
+        fwrite(&header, sizeof(header), 1, output);
+        if(header.rulesSize) {
+            fwrite(&rules, sizeof(rules), 1, output);
+        }
+        fwrite(taps, sizeof(KBReplayTap), header.tapCount, output);
+    }
+    
+    free(taps);
+    fclose(output);
+    printf("wrote %llu records of %d modes to %s (%llu inflated, %llu forged)\n",
+           (unsigned long long)count, knownModeCount, outputPath,
+           (unsigned long long)inflated, (unsigned long long)forged);
+    return 0;
+}
+
+static int failures = 0;
+
+static void expect(Verdict verdict, Verdict expected, const char *mode, const char *what)
+{
+    int ok = (verdict == expected);
+    printf("%-12s %-40s %-16s %s\n", mode, what, verdictNames[verdict], ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+// check the verdicts on a game of each known mode: as played, with a higher
+// claim, scored by forged rules it carries, and claiming a board of another
+// size. the forged ones add up by their own rules - only the mode gives them away
+static int selfTest(uint64_t seed)
+{
+    KBRandom random;
+    KBRandomSeed(&random, seed);
+    
+    Worker worker;
+    memset(&worker, 0, sizeof(worker));
+    
+    size_t capacity = sizeof(KBReplayHeader) + sizeof(KBScoringRules) + MAX_GENERATED_TAPS * sizeof(KBReplayTap);
+    uint8_t *record = malloc(capacity);
+    KBReplayHeader *header = (KBReplayHeader*)record;
+    KBReplayTap *taps = malloc(MAX_GENERATED_TAPS * sizeof(KBReplayTap));
+    uint32_t score;
+    
+    for(int m=0; m<knownModeCount; m++) {
+        const KnownMode *mode = &knownModes[m];
+        KBScoringRules forged;
+        forgeRules(mode, &forged);
+        
+        for(int forging=0; forging<2; forging++) {
+            const KBScoringRules *rules = forging ? &forged : &mode->rules;
+            
+            playGame(mode, rules, &random, header, taps);
+            if(header->rulesSize) {
+                memcpy(record + sizeof(KBReplayHeader), rules, sizeof(KBScoringRules));
+            }
+            memcpy((void*)KBReplayTaps(header), taps, header->tapCount * sizeof(KBReplayTap));
+            
+            if(forging) {
+                expect(validate(&worker, header, capacity, &score), VERDICT_UNKNOWN_MODE,
+                       mode->name, "scored by forged rules");
+                continue;
+            }
+            
+            expect(validate(&worker, header, capacity, &score), VERDICT_VALID, mode->name, "as played");
+            
+            header->claimedScore += 10;
+            expect(validate(&worker, header, capacity, &score), VERDICT_SCORE_MISMATCH, mode->name, "claiming more");
+            header->claimedScore -= 10;
+            
+            // the same game claimed on a board with a row more
+            header->rows += 1;
+            expect(validate(&worker, header, capacity, &score), VERDICT_UNKNOWN_MODE, mode->name, "on a board of its own");
+            header->rows -= 1;
+        }
+    }
+    
+    free(worker.board);
+    free(worker.tables);
+    free(taps);
+    free(record);
+    
+    if(failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t generateCount = 0;
+    uint64_t seed = 2013;
+    int modeFiles = 0;
+    int test = 0;
+    
+    int option;
+    while((option = getopt(argc, argv, "t:G:s:m:T")) != -1) {
+        switch(option) {
+            case 't': workerCount = atoi(optarg); break;
+            case 'G': generateCount = strtoull(optarg, NULL, 10); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 'm':
+                if(!loadModes(optarg)) {
+                    return 1;
+                }
+                ++modeFiles;
+                break;
+            case 'T': test = 1; break;
+            default: return 1;
+        }
+    }
+    
+    if(modeFiles == 0 && !loadModes(SHIPPED_MODES_PATH)) {
+        return 1;
+    }
+    if(knownModeCount == 0) {
+        fprintf(stderr, "no known modes\n");
+        return 1;
+    }
+    
+    if(test) {
+        return selfTest(seed);
+    }
+    
+    if(generateCount > 0) {
+        if(optind + 1 != argc) {
+            fprintf(stderr, "usage: %s -G count [-s seed] [-m modes.json]... output\n", argv[0]);
+            return 1;
+        }
+        return generate(argv[optind], generateCount, seed);
+    }
+    
+    if(optind + 2 != argc || workerCount < 1) {
+        fprintf(stderr, "usage: %s [-t threads] [-m modes.json]... input verdicts\n", argv[0]);
+        return 1;
+    }
+    
+    return runValidation(argv[optind], argv[optind+1], workerCount);
+}